@@ -3,6 +3,7 @@
 # Auxiliary program to test the normalization algorithm
 #
 
+import contextlib
 import csv
 import os
 import subprocess
@@ -29,6 +30,12 @@ def check_owl(f, owl):
 	return spot.formula(line.decode('ascii')) if line else None
 
 
+def check_py(f, module):
+	"""Get the normal form from the C++ implementation in process"""
+
+	return module.normalize(f)
+
+
 def handle_error(proc, imp):
 	"""Show information about unrecoverable errors of the implementation"""
 
@@ -56,11 +63,19 @@ def benchmark_formulae(args, ifile, impls, csvw):
 		# Implementation are handled sequentially
 		for imp, command in impls.items():
 
-			check_fn = check_owl
 			num_errors = 0
 
-			# We repeatedly write a formula to the process and wait to obtain its normal form
-			with subprocess.Popen(command, stdin=subprocess.PIPE, stdout=subprocess.PIPE) as proc:
+			# The in-process implementation is called through the Python module,
+			# the others by repeatedly writing a formula to the process and waiting
+			# to obtain its normal form
+			if command is None:
+				import ltlnorm
+				check_fn, context = check_py, contextlib.nullcontext(ltlnorm)
+			else:
+				check_fn = check_owl
+				context = subprocess.Popen(command, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+
+			with context as proc:
 				for k, f_text in enumerate(ifile):
 					f_text = f_text.rstrip()
 
@@ -105,9 +120,10 @@ def benchmark_formulae(args, ifile, impls, csvw):
 					               number_of_nodes(result), dag_size(result), final_normal,
 					               normalized_GF(result)])
 
-				proc.stdin.close()
-				proc.terminate()
-				proc.wait(timeout=2)
+				if command is not None:
+					proc.stdin.close()
+					proc.terminate()
+					proc.wait(timeout=2)
 
 				print(f'Finished with {imp}: {num_errors} errors.')
 				ifile.seek(0)
@@ -124,7 +140,7 @@ if __name__ == '__main__':
 
 	parser = argparse.ArgumentParser(description='Test and benchmark the normalization algorithms')
 	parser.add_argument('test', help='Test to be run')
-	parser.add_argument('--imp', '-i', help='Choose which implementations to consider (among owl, cpp)',
+	parser.add_argument('--imp', '-i', help='Choose which implementations to consider (among owl, cpp, py)',
 	                    default='owl,cpp')
 	parser.add_argument('--equiv-check', help='Check whether the normal form is equivalent to the input formula',
 	                    action='store_true')
@@ -135,6 +151,7 @@ if __name__ == '__main__':
 	COMMANDS = {
 		'owl': ['owl/bin/owl', 'ltl2delta2', '--method', 'SE20_SIGMA_2_AND_GF_SIGMA_1', '--strict'],
 		'cpp': [os.getenv('LTLNORM_PATH') or 'build/ltlnorm'],
+		'py': None,  # ltlnorm Python module (built with -Dpython=true)
 	}
 
 	# Select the implementation given in the --imp argument
@@ -9,6 +9,15 @@ import sys
 
 import pandas as pd
 
+# Step of the normalizer applying each rule (numbered as in normalizer.cc)
+RULE_STEPS = {
+	'rule1': 'removeWU',
+	'rule2': 'removeWU',
+	'rule3': 'removeGF',
+	'rule4': 'fixGF',
+	'rule5': 'fixGF',
+}
+
 
 def emph(s):
 	"""Emphasize text to make it more readable"""
@@ -105,6 +114,48 @@ def process_file(filename, ignore_normalized=False):
 	return summary
 
 
+def process_stats_file(filename):
+	"""Summarize the statistics written by ltlnorm --stats=csv"""
+
+	data = pd.read_csv(filename)
+	phases = [column[5:] for column in data.columns if column.startswith('time_')]
+	rules = [column for column in data.columns if column.startswith('rule')]
+
+	return {
+		'file': filename,
+		'formulae': len(data),
+		# Total time of each phase in milliseconds
+		'phase_time': {phase: data[f'time_{phase}'].sum() / 1e6 for phase in phases},
+		'rule_applications': {rule: int(data[rule].sum()) for rule in rules},
+		'mean_allocated': data.allocated.mean(),
+		'max_peak_live': int(data.peak_live.max()),
+		'max_peak_bytes': int(data.peak_bytes.max()),
+		'mean_blowup': (data.fin_size / data.init_size).mean(),
+		'mean_blowup_dag': (data.fin_dagsize / data.init_dagsize).mean(),
+	}
+
+
+def print_stats(summary):
+	"""Print the summary of the ltlnorm statistics to the command line"""
+
+	print(emph('File:'), summary['file'])
+	print(emph('Formulae:'), summary['formulae'])
+
+	print('\nTotal time by phase (ms):')
+	for phase, time in summary['phase_time'].items():
+		print(f'\t{emph(phase)}\t', round(time, 3))
+
+	print('\nRule applications:')
+	for rule, count in summary['rule_applications'].items():
+		print(f'\t{emph(rule)} ({RULE_STEPS.get(rule, "?")})\t', count)
+
+	print(emph('\nMean allocated nodes:'), round(summary['mean_allocated'], 2))
+	print(emph('Maximum peak of live nodes:'), summary['max_peak_live'])
+	print(emph('Maximum peak of memory (bytes):'), summary['max_peak_bytes'])
+	print(emph('Mean blow-up:'), round(summary['mean_blowup'], 3))
+	print(emph('Mean blow-up (DAG):'), round(summary['mean_blowup_dag'], 3))
+
+
 def print_results(summary):
 	"""Print the summary of the results to the command line"""
 
@@ -154,15 +205,26 @@ if __name__ == '__main__':
 	parser.add_argument('-o', help='Write the summary in JSON format to the given file', type=str)
 	args = parser.parse_args()
 
-	summary = [process_file(filename, ignore_normal)
+	def process(filename, ignore_normal):
+		# Statistics written by ltlnorm itself have no implementation column
+		with open(filename) as csvfile:
+			if 'imp' not in csvfile.readline().rstrip().split(','):
+				return process_stats_file(filename)
+
+		return process_file(filename, ignore_normal)
+
+	def show(entry):
+		(print_results if 'implementations' in entry else print_stats)(entry)
+
+	summary = [process(filename, ignore_normal)
 	           for filename, ignore_normal in map(decode_filename, args.csvfile)]
 
 	if args.o:
 		with open(args.o, 'w') as ofile:
 			json.dump(summary, ofile)
 
-	print_results(summary[0])
+	show(summary[0])
 
 	for entry in summary[1:]:
 		print('-' * 80)
-		print_results(entry)
+		show(entry)
@@ -0,0 +1,628 @@
+/**
+ * @file bench.cc
+ *
+ * Benchmark of the normalizer on files of formulae (in-process).
+ *
+ * Each formula is read, normalized and written in the Spot format for a
+ * number of warmup iterations and then for a number of measured iterations.
+ * Parametric families of formulae (see families.hh) can also be swept over
+ * their size parameter, fitting a growth model to the time, the peak of live
+ * nodes and the output size. The results can be written in JSON format and
+ * compared with a previous run, failing if the total time of a file or the
+ * growth rate of the time of a family has increased beyond a threshold.
+ * Formulae can be simplified before their normalization, reporting the
+ * triggers of the rules removed, so that comparing with a baseline without
+ * simplification gives the reduction of the time. Likewise, formulae can
+ * be normalized by the Spot engine (see spotnorm.hh) to be compared with a
+ * baseline of the node engine.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "estimate.hh"
+#include "families.hh"
+#include "normalizer.hh"
+#include "pipeline.hh"
+#include "stats.hh"
+
+using namespace std;
+
+struct BenchOptions
+{
+	unsigned iterations = 20;
+	unsigned warmup = 3;
+	bool perFormula = false;        // Report the results of each formula
+	const char* output = nullptr;   // Write the results in JSON format
+	const char* baseline = nullptr; // Compare against previous results
+	double threshold = 10;          // Tolerated slowdown in percentage
+	unsigned simplify = 0;          // Level of simplification (see pipeline.hh)
+	Engine engine = Engine::NODE;   // Normalization engine
+	vector<const char*> files;
+
+	vector<const Family*> families;
+	unsigned maxSize = 20;   // Maximum size parameter of the families
+	double timeLimit = 1e9;  // Stop the sweep when a formula takes longer (ns)
+};
+
+struct FormulaResult
+{
+	string formula;
+	uint64_t median;    // Nanoseconds
+	uint64_t p99;       // Nanoseconds
+	uint64_t allocated; // Nodes allocated in a single run
+	int64_t peakLive;   // Peak of live nodes in a single run
+	size_t outTree;     // Size of the normal form
+	size_t outDag;
+};
+
+struct FileResult
+{
+	string file;
+	vector<FormulaResult> formulae;
+	uint64_t total = 0; // Sum of the medians of the formulae
+	uint64_t median = 0;
+	uint64_t p99 = 0;
+	uint64_t allocated = 0;
+	double triggers = 0;           // Triggers of the rules in the input formulae
+	double simplifiedTriggers = 0; // The same after the simplification
+};
+
+struct FamilyResult
+{
+	const Family* family;
+	vector<unsigned> sizes;
+	vector<FormulaResult> formulae;
+	uint64_t total = 0; // Sum of the medians of the formulae
+	GrowthFit time;
+	GrowthFit memory;
+	GrowthFit output;
+};
+
+/**
+ * Percentile of a sorted sample (nearest rank).
+ */
+inline uint64_t
+percentile(const vector<uint64_t>& sorted, unsigned percent)
+{
+	if (sorted.empty())
+		return 0;
+
+	const size_t rank = (sorted.size() * percent + 99) / 100;
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * Read, normalize and write a formula.
+ *
+ * @return Whether the formula could be read.
+ */
+bool
+runOnce(const string& text, const BenchOptions& options)
+{
+	// The sizes of the output are recorded by the Spot engine
+	if (options.engine == Engine::SPOT)
+		return !normalizeWithSpot(text).empty();
+
+	NodeRef input(readFormula(text, Format::SPOT));
+
+	if (!input)
+		return false;
+
+	input = NodeRef(simplifyFormula(input.get(), options.simplify));
+
+	NodeRef output(normalize(input.get()));
+	writeFormula(output.get(), Format::SPOT);
+
+	if (FormulaStats* stats = FormulaStats::current) {
+		stats->outTree = treeSize(output.get());
+		stats->outDag = dagSize(output.get());
+	}
+
+	return true;
+}
+
+bool
+benchFormula(const string& text, const BenchOptions& options, FormulaResult& result)
+{
+	for (unsigned i = 0; i < options.warmup; ++i)
+		if (!runOnce(text, options))
+			return false;
+
+	vector<uint64_t> times(options.iterations);
+
+	for (uint64_t& time : times) {
+		const auto start = chrono::steady_clock::now();
+		runOnce(text, options);
+		const auto elapsed = chrono::steady_clock::now() - start;
+		time = chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+	}
+
+	sort(times.begin(), times.end());
+
+	// Allocations are counted in a separate run not to disturb the timings
+	FormulaStats stats;
+	{
+		StatsScope scope(&stats);
+		runOnce(text, options);
+	}
+
+	result = { text,           percentile(times, 50), percentile(times, 99), stats.allocated,
+		         stats.peakLive, stats.outTree,         stats.outDag };
+	return true;
+}
+
+bool
+benchFile(const char* path, const BenchOptions& options, FileResult& result)
+{
+	ifstream in(path);
+
+	if (!in) {
+		cerr << "Error: cannot open " << path << ".\n";
+		return false;
+	}
+
+	result.file = path;
+	string line;
+
+	while (getline(in, line)) {
+		if (line.empty())
+			continue;
+
+		FormulaResult formula;
+
+		if (!benchFormula(line, options, formula)) {
+			cerr << "Warning: ignoring malformed formula in " << path << ": " << line << "\n";
+			continue;
+		}
+
+		result.formulae.push_back(move(formula));
+
+		if (options.simplify > 0) {
+			NodeRef input(readFormula(line, Format::SPOT));
+			result.triggers += estimateCost(input.get()).triggers();
+
+			NodeRef simplified(simplifyFormula(input.get(), options.simplify));
+			result.simplifiedTriggers += estimateCost(simplified.get()).triggers();
+		}
+	}
+
+	vector<uint64_t> medians;
+	medians.reserve(result.formulae.size());
+
+	for (const FormulaResult& formula : result.formulae) {
+		result.total += formula.median;
+		result.allocated += formula.allocated;
+		medians.push_back(formula.median);
+	}
+
+	sort(medians.begin(), medians.end());
+	result.median = percentile(medians, 50);
+	result.p99 = percentile(medians, 99);
+
+	return true;
+}
+
+bool
+benchFamily(const Family* family, const BenchOptions& options, FamilyResult& result)
+{
+	result.family = family;
+
+	for (unsigned size = 1; size <= options.maxSize; ++size) {
+		FormulaResult formula;
+
+		if (!benchFormula(family->generate(size), options, formula)) {
+			cerr << "Error: malformed formula of family " << family->name << ".\n";
+			return false;
+		}
+
+		result.sizes.push_back(size);
+		result.formulae.push_back(move(formula));
+		result.total += result.formulae.back().median;
+
+		// Larger sizes would take even longer
+		if (result.formulae.back().median > options.timeLimit)
+			break;
+	}
+
+	vector<double> times, memory, output;
+
+	for (const FormulaResult& formula : result.formulae) {
+		times.push_back(formula.median);
+		memory.push_back(formula.peakLive);
+		output.push_back(formula.outDag);
+	}
+
+	result.time = fitGrowth(result.sizes, times);
+	result.memory = fitGrowth(result.sizes, memory);
+	result.output = fitGrowth(result.sizes, output);
+
+	return true;
+}
+
+//
+//	Reporting and comparison with a baseline
+//
+
+void
+printQuotedJson(ostream& out, const string& text)
+{
+	out << '"';
+
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			out << '\\';
+		out << c;
+	}
+
+	out << '"';
+}
+
+/**
+ * Write the results in JSON format, with a line for each file, so that
+ * they can be read back without a JSON parser.
+ */
+void
+writeJson(ostream& out, const vector<FileResult>& results,
+          const vector<FamilyResult>& familyResults, const BenchOptions& options)
+{
+	out << "{\"iterations\": " << options.iterations << ", \"files\": [\n";
+
+	for (size_t i = 0; i < results.size(); ++i) {
+		const FileResult& file = results[i];
+
+		out << "{\"file\": ";
+		printQuotedJson(out, file.file);
+		out << ", \"total\": " << file.total << ", \"median\": " << file.median
+		    << ", \"p99\": " << file.p99 << ", \"allocated\": " << file.allocated;
+
+		if (options.perFormula) {
+			out << ", \"formulae\": [";
+
+			for (size_t j = 0; j < file.formulae.size(); ++j) {
+				const FormulaResult& formula = file.formulae[j];
+
+				out << (j ? ", " : "") << "{\"formula\": ";
+				printQuotedJson(out, formula.formula);
+				out << ", \"median\": " << formula.median << ", \"p99\": " << formula.p99
+				    << ", \"allocated\": " << formula.allocated << "}";
+			}
+
+			out << "]";
+		}
+
+		out << (i + 1 < results.size() ? "},\n" : "}\n");
+	}
+
+	out << "], \"families\": [\n";
+
+	for (size_t i = 0; i < familyResults.size(); ++i) {
+		const FamilyResult& family = familyResults[i];
+
+		out << "{\"family\": \"" << family.family->name << "\", \"total\": " << family.total;
+
+		const pair<const char*, const GrowthFit&> fits[] = { { "time", family.time },
+			                                                   { "memory", family.memory },
+			                                                   { "output", family.output } };
+
+		for (auto& [name, fit] : fits)
+			out << ", \"" << name << "_model\": \"" << GrowthFit::modelName(fit.model)
+			    << "\", \"" << name << "_rate\": " << fit.rate;
+
+		// Each point is the size, median time, peak of live nodes,
+		// and tree and DAG sizes of the output
+		out << ", \"points\": [";
+
+		for (size_t j = 0; j < family.formulae.size(); ++j) {
+			const FormulaResult& formula = family.formulae[j];
+			out << (j ? ", [" : "[") << family.sizes[j] << ", " << formula.median << ", "
+			    << formula.peakLive << ", " << formula.outTree << ", " << formula.outDag << "]";
+		}
+
+		out << (i + 1 < familyResults.size() ? "]},\n" : "]}\n");
+	}
+
+	out << "]}\n";
+}
+
+/**
+ * Extract a field of a line of the JSON results (as text).
+ */
+bool
+field(const string& line, const char* name, string& value)
+{
+	const string key = string("\"") + name + "\": ";
+	size_t start = line.find(key);
+
+	if (start == string::npos)
+		return false;
+
+	start += key.size();
+	const bool quoted = line[start] == '"';
+	const size_t end = quoted ? line.find('"', ++start) : line.find_first_of(",}", start);
+
+	if (end == string::npos)
+		return false;
+
+	value = line.substr(start, end - start);
+	return true;
+}
+
+/**
+ * Read the lines of the results of each file and family from a baseline
+ * written by writeJson (file names with quotes are not expected).
+ */
+bool
+readBaseline(const char* path, map<string, string>& files, map<string, string>& families)
+{
+	ifstream in(path);
+
+	if (!in) {
+		cerr << "Error: cannot open the baseline " << path << ".\n";
+		return false;
+	}
+
+	string line, name;
+
+	while (getline(in, line)) {
+		if (field(line, "file", name))
+			files[name] = line;
+		else if (field(line, "family", name))
+			families[name] = line;
+	}
+
+	return true;
+}
+
+/**
+ * Print the relative change of a measure with respect to the baseline.
+ *
+ * @return Whether the change is within the threshold.
+ */
+bool
+reportChange(const string& name, const char* measure, double value, double baseline,
+             const BenchOptions& options)
+{
+	const double change = 100.0 * (value / baseline - 1);
+	const bool regression = change > options.threshold;
+
+	cout << name << ": " << measure << " " << (change >= 0 ? "+" : "") << change
+	     << "% against the baseline" << (regression ? " (REGRESSION)" : "") << "\n";
+
+	return !regression;
+}
+
+bool
+compareBaseline(const vector<FileResult>& results, const vector<FamilyResult>& familyResults,
+                const BenchOptions& options)
+{
+	map<string, string> files, families;
+
+	if (!readBaseline(options.baseline, files, families))
+		return false;
+
+	bool ok = true;
+	string text;
+
+	for (const FileResult& file : results) {
+		auto it = files.find(file.file);
+
+		if (it == files.end() || !field(it->second, "total", text) || stod(text) == 0)
+			cout << file.file << ": not in the baseline\n";
+		else
+			ok = reportChange(file.file, "total time", file.total, stod(text), options) && ok;
+	}
+
+	// The growth of the time is compared for families, since their totals
+	// depend on the number of sizes run within the time limit
+	for (const FamilyResult& family : familyResults) {
+		auto it = families.find(family.family->name);
+		string model;
+
+		if (it == families.end() || !field(it->second, "time_model", model) ||
+		    !field(it->second, "time_rate", text))
+			cout << family.family->name << ": not in the baseline\n";
+
+		else if (model == "polynomial" && family.time.model == GrowthFit::EXPONENTIAL) {
+			cout << family.family->name << ": time growth became exponential (REGRESSION)\n";
+			ok = false;
+		}
+
+		else if (model == GrowthFit::modelName(family.time.model) && stod(text) > 0)
+			ok = reportChange(family.family->name, "time growth rate", family.time.rate,
+			                  stod(text), options) &&
+			     ok;
+	}
+
+	return ok;
+}
+
+void
+printResults(const vector<FileResult>& results, const BenchOptions& options)
+{
+	for (const FileResult& file : results) {
+		cout << file.file << ": " << file.formulae.size() << " formulae, total "
+		     << file.total / 1e6 << " ms, median " << file.median / 1e3 << " us, p99 "
+		     << file.p99 / 1e3 << " us, " << file.allocated << " nodes allocated";
+
+		if (options.simplify > 0)
+			cout << ", triggers " << file.triggers << " -> " << file.simplifiedTriggers;
+
+		cout << "\n";
+
+		if (options.perFormula)
+			for (const FormulaResult& formula : file.formulae)
+				cout << "  " << formula.median / 1e3 << " us (p99 " << formula.p99 / 1e3
+				     << " us, " << formula.allocated << " nodes) " << formula.formula << "\n";
+	}
+}
+
+void
+printFamilies(const vector<FamilyResult>& results)
+{
+	for (const FamilyResult& family : results) {
+		cout << "Family " << family.family->name << " (" << family.family->description
+		     << "):\n";
+
+		for (size_t i = 0; i < family.formulae.size(); ++i) {
+			const FormulaResult& formula = family.formulae[i];
+			cout << "  n=" << family.sizes[i] << ": " << formula.median / 1e3 << " us, peak "
+			     << formula.peakLive << " nodes, output tree " << formula.outTree << " dag "
+			     << formula.outDag << "\n";
+		}
+
+		cout << "  time " << describeGrowth(family.time) << ", memory "
+		     << describeGrowth(family.memory) << ", output " << describeGrowth(family.output)
+		     << "\n";
+	}
+}
+
+//
+//	Command-line options
+//
+
+void
+usage(const char* progname)
+{
+	cerr << "Usage: " << progname << " [options] file...\n\n"
+	     << "Benchmark the normalization of the formulae in the given files\n"
+	     << "and of parametric families of formulae.\n\n"
+	     << "Options:\n"
+	     << "  --iterations=N   measured iterations per formula (20 by default)\n"
+	     << "  --warmup=N       warmup iterations per formula (3 by default)\n"
+	     << "  --per-formula    report the results of each formula\n"
+	     << "  --output=PATH    write the results in JSON format\n"
+	     << "  --baseline=PATH  compare with the results of a previous run and\n"
+	     << "                   fail if the total time of a file has increased\n"
+	     << "  --threshold=PCT  tolerated increase of time (10% by default)\n"
+	     << "  --simplify=N     simplify the formulae before normalizing them\n"
+	     << "                   at the given level (as in ltlnorm) and report\n"
+	     << "                   the triggers of the rules before and after\n"
+	     << "  --engine=NAME    normalization engine (node by default or spot, as\n"
+	     << "                   in ltlnorm, without simplification)\n"
+	     << "  --family=NAMES   sweep the size of the given families of formulae\n"
+	     << "                   (separated by commas, or all)\n"
+	     << "  --max-size=N     maximum size of the families (20 by default)\n"
+	     << "  --time-limit=S   stop the sweep when a formula takes longer than\n"
+	     << "                   the given seconds (1 by default)\n\n"
+	     << "Families:\n";
+
+	for (const Family& family : families)
+		cerr << "  " << family.name << ": " << family.description << "\n";
+}
+
+bool
+parseFamilies(const char* names, BenchOptions& options)
+{
+	if (strcmp(names, "all") == 0) {
+		for (const Family& family : families)
+			options.families.push_back(&family);
+		return true;
+	}
+
+	string list = names;
+	size_t start = 0;
+
+	while (start <= list.size()) {
+		size_t end = min(list.find(',', start), list.size());
+		const Family* family = findFamily(list.substr(start, end - start));
+
+		if (!family)
+			return false;
+
+		options.families.push_back(family);
+		start = end + 1;
+	}
+
+	return true;
+}
+
+bool
+parseOptions(int argc, char* argv[], BenchOptions& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		char* end = nullptr;
+
+		if (strncmp(arg, "--iterations=", 13) == 0)
+			options.iterations = strtoul(arg + 13, &end, 10);
+		else if (strncmp(arg, "--warmup=", 9) == 0)
+			options.warmup = strtoul(arg + 9, &end, 10);
+		else if (strcmp(arg, "--per-formula") == 0)
+			options.perFormula = true;
+		else if (strncmp(arg, "--output=", 9) == 0)
+			options.output = arg + 9;
+		else if (strncmp(arg, "--baseline=", 11) == 0)
+			options.baseline = arg + 11;
+		else if (strncmp(arg, "--threshold=", 12) == 0)
+			options.threshold = strtod(arg + 12, &end);
+		else if (strncmp(arg, "--simplify=", 11) == 0) {
+			options.simplify = strtoul(arg + 11, &end, 10);
+
+			if (options.simplify > maxSimplifyLevel)
+				return false;
+		}
+		else if (strncmp(arg, "--engine=", 9) == 0) {
+			if (!parseEngine(arg + 9, options.engine))
+				return false;
+		} else if (strncmp(arg, "--family=", 9) == 0) {
+			if (!parseFamilies(arg + 9, options))
+				return false;
+		} else if (strncmp(arg, "--max-size=", 11) == 0)
+			options.maxSize = strtoul(arg + 11, &end, 10);
+		else if (strncmp(arg, "--time-limit=", 13) == 0)
+			options.timeLimit = strtod(arg + 13, &end) * 1e9;
+		else if (arg[0] == '-')
+			return false;
+		else
+			options.files.push_back(arg);
+
+		if (end && *end != '\0')
+			return false;
+	}
+
+	return (!options.files.empty() || !options.families.empty()) && options.iterations > 0 &&
+	       (options.engine == Engine::NODE || options.simplify == 0);
+}
+
+int
+main(int argc, char* argv[])
+{
+	BenchOptions options;
+
+	if (!parseOptions(argc, argv, options)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	vector<FileResult> results(options.files.size());
+
+	for (size_t i = 0; i < options.files.size(); ++i)
+		if (!benchFile(options.files[i], options, results[i]))
+			return 1;
+
+	vector<FamilyResult> familyResults(options.families.size());
+
+	for (size_t i = 0; i < options.families.size(); ++i)
+		if (!benchFamily(options.families[i], options, familyResults[i]))
+			return 1;
+
+	printResults(results, options);
+	printFamilies(familyResults);
+
+	if (options.output) {
+		ofstream out(options.output);
+		writeJson(out, results, familyResults, options);
+	}
+
+	const bool ok = !options.baseline || compareBaseline(results, familyResults, options);
+	Node::releaseStaticNodes();
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,288 @@
+/**
+ * @file binio.cc
+ *
+ * Read and write batches of formulae in a binary format.
+ */
+
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binio.hh"
+
+using namespace std;
+using namespace binio;
+using Op = Node::Op;
+
+constexpr uint32_t byteOrderMark = 0x01020304;
+
+//
+//	Writing
+//
+
+size_t
+BatchWriter::KeyHash::operator()(const vector<uint32_t>& key) const
+{
+	// FNV-1a hash of the words in the key
+	size_t hash = 14695981039346656037ull;
+
+	for (uint32_t word : key)
+		hash = (hash ^ word) * 1099511628211ull;
+
+	return hash;
+}
+
+uint32_t
+BatchWriter::addNode(const Node* node, unordered_map<const Node*, uint32_t>& indices)
+{
+	auto it = indices.find(node);
+
+	if (it != indices.end())
+		return it->second;
+
+	// The key of a node is its operator followed by the index of
+	// its atomic proposition or by the indices of its arguments
+	vector<uint32_t> key{ uint32_t(node->type) };
+
+	if (is(node, Op::APROP)) {
+		auto [pit, inserted] = propIndices.emplace(node->name, propIndices.size());
+
+		if (inserted) {
+			pool += node->name;
+			propOffsets.push_back(pool.size());
+		}
+
+		key.push_back(pit->second);
+	} else
+		for (const Node* child : node->children)
+			key.push_back(addNode(child, indices));
+
+	auto [nit, inserted] = nodeIndices.emplace(move(key), nodes.size());
+
+	if (inserted) {
+		const vector<uint32_t>& nodeKey = nit->first;
+
+		if (is(node, Op::APROP))
+			nodes.push_back({ nodeKey[0], nodeKey[1], 0 });
+		else {
+			nodes.push_back({ nodeKey[0], uint32_t(args.size()),
+			                  uint32_t(nodeKey.size() - 1) });
+			args.insert(args.end(), nodeKey.begin() + 1, nodeKey.end());
+		}
+	}
+
+	return indices[node] = nit->second;
+}
+
+void
+BatchWriter::add(const Node* formula)
+{
+	// Indices by address are only valid while the formula is alive
+	unordered_map<const Node*, uint32_t> indices;
+	roots.push_back(formula ? addNode(formula, indices) : missing);
+}
+
+template<typename T>
+inline void
+writeArray(ostream& out, const vector<T>& array)
+{
+	out.write(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(T));
+}
+
+bool
+BatchWriter::write(ostream& out) const
+{
+	Header header = { { 'L', 'T', 'L', 'B' },
+		                version,
+		                byteOrderMark,
+		                uint32_t(propIndices.size()),
+		                uint32_t(nodes.size()),
+		                uint32_t(args.size()),
+		                uint32_t(roots.size()),
+		                uint32_t(pool.size()) };
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	writeArray(out, propOffsets);
+	writeArray(out, nodes);
+	writeArray(out, args);
+	writeArray(out, roots);
+	out.write(pool.data(), pool.size());
+
+	return bool(out.flush());
+}
+
+//
+//	Reading
+//
+
+BatchReader::~BatchReader()
+{
+	if (mapped)
+		munmap(mapped, mappedSize);
+}
+
+bool
+BatchReader::open(int fd)
+{
+	struct stat info;
+	const void* data = nullptr;
+	size_t size = 0;
+
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+		mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (mapped == MAP_FAILED)
+			mapped = nullptr;
+		else {
+			mappedSize = info.st_size;
+			data = mapped;
+			size = mappedSize;
+		}
+	}
+
+	// Otherwise, the file is read into an aligned buffer
+	if (!data) {
+		string contents;
+		char chunk[1 << 16];
+		ssize_t count;
+
+		while ((count = read(fd, chunk, sizeof(chunk))) > 0)
+			contents.append(chunk, count);
+
+		if (contents.empty()) {
+			cerr << "Error: empty binary batch.\n";
+			return false;
+		}
+
+		buffer.resize((contents.size() + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+		memcpy(buffer.data(), contents.data(), contents.size());
+		data = buffer.data();
+		size = contents.size();
+	}
+
+	header = static_cast<const Header*>(data);
+
+	if (!validate(size)) {
+		header = nullptr;
+		return false;
+	}
+
+	props.resize(header->nrProps);
+
+	for (uint32_t i = 0; i < header->nrProps; ++i)
+		props[i] = Node::ap(string(pool + propOffsets[i], propOffsets[i + 1] - propOffsets[i]));
+
+	return true;
+}
+
+bool
+BatchReader::validate(size_t size)
+{
+	if (size < sizeof(Header) || memcmp(header->magic, "LTLB", 4) != 0) {
+		cerr << "Error: not a binary batch of formulae.\n";
+		return false;
+	}
+
+	if (header->byteOrder != byteOrderMark || header->version != version) {
+		cerr << "Error: unsupported version or byte order of the binary batch.\n";
+		return false;
+	}
+
+	// Positions of the arrays (all the counts fit in 32 bits)
+	const uint64_t nrWords = uint64_t(header->nrProps) + 1 + 3 * uint64_t(header->nrNodes) +
+	                         header->nrArgs + header->nrRoots;
+
+	if (sizeof(Header) + 4 * nrWords + header->poolSize != size) {
+		cerr << "Error: truncated or corrupted binary batch.\n";
+		return false;
+	}
+
+	propOffsets = reinterpret_cast<const uint32_t*>(header + 1);
+	nodes = reinterpret_cast<const Entry*>(propOffsets + header->nrProps + 1);
+	args = reinterpret_cast<const uint32_t*>(nodes + header->nrNodes);
+	roots = args + header->nrArgs;
+	pool = reinterpret_cast<const char*>(roots + header->nrRoots);
+
+	// Check that all indices are in range, so that the formulae
+	// can be built later without any further check
+	for (uint32_t i = 0; i < header->nrProps; ++i)
+		if (propOffsets[i] > propOffsets[i + 1] || propOffsets[i + 1] > header->poolSize) {
+			cerr << "Error: wrong name of atomic proposition " << i << " in binary batch.\n";
+			return false;
+		}
+
+	for (uint32_t i = 0; i < header->nrNodes; ++i) {
+		const Entry& entry = nodes[i];
+		bool ok = entry.type <= uint32_t(Op::FG);
+
+		if (ok && Op(entry.type) == Op::APROP)
+			ok = entry.first < header->nrProps;
+
+		else if (ok) {
+			const int expected = arity(Op(entry.type));
+
+			ok = (expected < 0 || entry.count == uint32_t(expected)) &&
+			     uint64_t(entry.first) + entry.count <= header->nrArgs;
+
+			for (uint32_t j = 0; ok && j < entry.count; ++j)
+				ok = args[entry.first + j] < i;
+		}
+
+		if (!ok) {
+			cerr << "Error: wrong node " << i << " in binary batch.\n";
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < header->nrRoots; ++i)
+		if (roots[i] != missing && roots[i] >= header->nrNodes) {
+			cerr << "Error: wrong formula " << i << " in binary batch.\n";
+			return false;
+		}
+
+	return true;
+}
+
+Node*
+BatchReader::build(uint32_t index, unordered_map<uint32_t, Node*>& built,
+                   vector<Node*>& table) const
+{
+	auto it = built.find(index);
+
+	if (it != built.end())
+		return it->second;
+
+	const Entry& entry = nodes[index];
+	const Op type = Op(entry.type);
+	Node* node;
+
+	if (type == Op::APROP)
+		node = props[entry.first];
+	else {
+		NodeList children(entry.count);
+
+		for (uint32_t i = 0; i < entry.count; ++i)
+			children[i] = build(args[entry.first + i], built, table);
+
+		node = Node::make(type, move(children));
+	}
+
+	// Shared nodes are kept alive by the table until the formula is complete
+	node->addUser();
+	table.push_back(node);
+
+	return built[index] = node;
+}
+
+Node*
+BatchReader::get(size_t index) const
+{
+	if (roots[index] == missing)
+		return nullptr;
+
+	unordered_map<uint32_t, Node*> built;
+	vector<Node*> table;
+
+	return releaseTable(table, build(roots[index], built, table));
+}
@@ -0,0 +1,163 @@
+/**
+ * @file binio.hh
+ *
+ * Read and write batches of formulae in a binary format.
+ *
+ * A batch file holds a single table of nodes shared by all its formulae,
+ * which can be mapped into memory and read without any parsing. It consists
+ * of a header followed by these arrays, all of them of 32-bit words in the
+ * byte order of the machine that wrote it (recorded in the header):
+ *
+ *  - the offsets of the names of the atomic propositions in the name pool
+ *    (one more than propositions, the last one is the size of the pool),
+ *  - the nodes as triples (operator, first, count), where the operator is
+ *    the position of the value in Node::Op, and first is the index of the
+ *    proposition for atomic propositions or the position of the first of
+ *    its count arguments in the argument array otherwise,
+ *  - the argument array with indices of nodes, always smaller than the
+ *    index of the node they are arguments of,
+ *  - the indices of the root nodes of the formulae, where the maximum
+ *    32-bit value stands for a missing formula,
+ *  - and the name pool of the atomic propositions.
+ */
+
+#ifndef BINIO_HH
+#define BINIO_HH
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tree.hh"
+
+namespace binio {
+
+/**
+ * Version of the binary format, increased on incompatible changes.
+ */
+constexpr uint32_t version = 1;
+
+/**
+ * Header of the binary format.
+ */
+struct Header
+{
+	char magic[4];      // "LTLB"
+	uint32_t version;   // Version of the format
+	uint32_t byteOrder; // 0x01020304 in the byte order of the file
+	uint32_t nrProps;   // Number of atomic propositions
+	uint32_t nrNodes;   // Number of nodes
+	uint32_t nrArgs;    // Size of the argument array
+	uint32_t nrRoots;   // Number of formulae
+	uint32_t poolSize;  // Size of the name pool in bytes
+};
+
+/**
+ * Node entry in the binary format.
+ */
+struct Entry
+{
+	uint32_t type;
+	uint32_t first;
+	uint32_t count;
+};
+
+/**
+ * Index of a missing formula.
+ */
+constexpr uint32_t missing = UINT32_MAX;
+
+} // namespace binio
+
+/**
+ * Batch of formulae to be written in the binary format.
+ */
+class BatchWriter
+{
+	public:
+	/**
+	 * Add a formula to the batch (or a missing formula if null).
+	 */
+	void add(const Node* formula);
+
+	/**
+	 * Write the batch to an output stream.
+	 */
+	bool write(std::ostream& out) const;
+
+	/**
+	 * Number of formulae in the batch.
+	 */
+	size_t size() const { return roots.size(); }
+
+	private:
+	struct KeyHash
+	{
+		size_t operator()(const std::vector<uint32_t>& key) const;
+	};
+
+	uint32_t addNode(const Node* node,
+	                 std::unordered_map<const Node*, uint32_t>& indices);
+
+	std::vector<uint32_t> propOffsets{ 0 };
+	std::string pool;
+	std::vector<binio::Entry> nodes;
+	std::vector<uint32_t> args;
+	std::vector<uint32_t> roots;
+
+	// Indices of the atomic propositions and of the nodes by their
+	// structure (operator and proposition or arguments)
+	std::unordered_map<std::string, uint32_t> propIndices;
+	std::unordered_map<std::vector<uint32_t>, uint32_t, KeyHash> nodeIndices;
+};
+
+/**
+ * Batch of formulae read from a binary file mapped into memory.
+ */
+class BatchReader
+{
+	public:
+	BatchReader() = default;
+	BatchReader(const BatchReader&) = delete;
+	~BatchReader();
+
+	/**
+	 * Map a batch file from a file descriptor (or read it if the descriptor
+	 * cannot be mapped, like a pipe).
+	 *
+	 * @return Whether the batch is valid. Otherwise, the error is reported
+	 * to the standard error.
+	 */
+	bool open(int fd);
+
+	/**
+	 * Number of formulae in the batch.
+	 */
+	size_t size() const { return header ? header->nrRoots : 0; }
+
+	/**
+	 * Build the formula at the given position (null if missing).
+	 */
+	Node* get(size_t index) const;
+
+	private:
+	bool validate(size_t size);
+	Node* build(uint32_t index, std::unordered_map<uint32_t, Node*>& built,
+	            std::vector<Node*>& table) const;
+
+	void* mapped = nullptr;
+	size_t mappedSize = 0;
+	std::vector<uint32_t> buffer; // when the file cannot be mapped
+
+	const binio::Header* header = nullptr;
+	const uint32_t* propOffsets = nullptr;
+	const binio::Entry* nodes = nullptr;
+	const uint32_t* args = nullptr;
+	const uint32_t* roots = nullptr;
+	const char* pool = nullptr;
+	std::vector<Node*> props;
+};
+
+#endif // BINIO_HH
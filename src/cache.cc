@@ -0,0 +1,343 @@
+/**
+ * @file cache.cc
+ *
+ * Persistent cache of normal forms shared by different runs.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.hh"
+#include "dagio.hh"
+#include "normalizer.hh"
+
+using namespace std;
+
+/**
+ * Advisory lock on a file held during the lifetime of the object.
+ */
+struct FileLock
+{
+	FileLock(int fd, int operation)
+	  : fd(fd)
+	{
+		while (flock(fd, operation) != 0 && errno == EINTR)
+			;
+	}
+
+	~FileLock() { flock(fd, LOCK_UN); }
+
+	int fd;
+};
+
+/**
+ * Current time in microseconds (to order the uses of the records).
+ */
+inline uint64_t
+now()
+{
+	using namespace chrono;
+	return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+inline string
+dagText(const Node* node)
+{
+	ostringstream out;
+	printDag(out, node);
+	return out.str();
+}
+
+PersistentCache::PersistentCache(const string& path, size_t maxSize)
+  : path(path)
+  , maxSize(maxSize)
+{}
+
+PersistentCache::~PersistentCache()
+{
+	if (lockFd >= 0) {
+		flushTouched();
+		close(lockFd);
+	}
+}
+
+bool
+PersistentCache::open()
+{
+	lockFd = ::open((path + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+
+	if (lockFd < 0) {
+		cerr << "Error: cannot open the cache lock " << path << ".lock: " << strerror(errno)
+		     << ".\n";
+		return false;
+	}
+
+	FileLock lock(lockFd, LOCK_SH);
+	return refresh();
+}
+
+//
+//	Reading and writing records (always with the lock held)
+//
+//	R <key> <last use> <input>\t<output>
+//	T <key> <last use>
+//
+
+void
+PersistentCache::parseRecords(const string& text)
+{
+	istringstream in(text);
+	string line;
+
+	while (getline(in, line)) {
+		istringstream record(line);
+		char kind;
+		uint64_t key, lastUse;
+
+		if (!(record >> kind >> hex >> key >> dec >> lastUse))
+			continue;
+
+		if (kind == 'R') {
+			string input, output;
+			record.get();
+
+			if (getline(record, input, '\t') && getline(record, output))
+				entries[key] = { move(input), move(output), lastUse };
+		} else if (kind == 'T') {
+			auto it = entries.find(key);
+
+			if (it != entries.end())
+				it->second.lastUse = max(it->second.lastUse, lastUse);
+		}
+	}
+}
+
+bool
+PersistentCache::refresh()
+{
+	struct stat info;
+
+	if (stat(path.c_str(), &info) != 0) {
+		entries.clear();
+		inode = 0;
+		readOffset = 0;
+
+		// The cache file has not been created yet
+		if (errno == ENOENT)
+			return true;
+
+		cerr << "Error: cannot access the cache " << path << ": " << strerror(errno) << ".\n";
+		return false;
+	}
+
+	// The file has been replaced by a compaction
+	if (info.st_ino != inode) {
+		entries.clear();
+		inode = info.st_ino;
+		readOffset = 0;
+	}
+
+	if (info.st_size <= readOffset)
+		return true;
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+
+	if (fd < 0) {
+		cerr << "Error: cannot open the cache " << path << ": " << strerror(errno) << ".\n";
+		return false;
+	}
+
+	string text(info.st_size - readOffset, '\0');
+	ssize_t count = pread(fd, text.data(), text.size(), readOffset);
+	close(fd);
+
+	if (count < 0)
+		return false;
+
+	// Records are always appended whole, but just in case
+	text.resize(text.rfind('\n', count - 1) + 1);
+	parseRecords(text);
+	readOffset += text.size();
+
+	return true;
+}
+
+bool
+PersistentCache::append(const string& text)
+{
+	int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+
+	if (fd < 0)
+		return false;
+
+	bool ok = write(fd, text.data(), text.size()) == ssize_t(text.size());
+	close(fd);
+
+	return ok && refresh();
+}
+
+void
+PersistentCache::compact()
+{
+	// The most recently used records are kept up to three quarters of
+	// the maximum size (to avoid compacting again soon)
+	vector<pair<uint64_t, uint64_t>> byUse;
+	byUse.reserve(entries.size());
+
+	for (auto& [key, entry] : entries)
+		byUse.emplace_back(entry.lastUse, key);
+
+	sort(byUse.rbegin(), byUse.rend());
+
+	ostringstream out;
+	size_t kept = 0;
+
+	for (auto [lastUse, key] : byUse) {
+		const Entry& entry = entries[key];
+		ostringstream record;
+		record << "R " << hex << key << dec << ' ' << lastUse << ' ' << entry.input << '\t'
+		       << entry.output << '\n';
+
+		if (size_t(out.tellp()) + record.str().size() > maxSize / 4 * 3)
+			break;
+
+		out << record.str();
+		kept++;
+	}
+
+	const string tmpPath = path + ".tmp" + to_string(getpid());
+	int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0)
+		return;
+
+	const string text = out.str();
+	bool ok = write(fd, text.data(), text.size()) == ssize_t(text.size());
+	close(fd);
+
+	if (ok && rename(tmpPath.c_str(), path.c_str()) == 0) {
+		statistics.evicted += entries.size() - kept;
+		refresh();
+	} else
+		unlink(tmpPath.c_str());
+}
+
+void
+PersistentCache::flushTouched()
+{
+	if (touched.empty())
+		return;
+
+	ostringstream out;
+	const uint64_t stamp = now();
+
+	for (uint64_t key : touched)
+		out << "T " << hex << key << dec << ' ' << stamp << '\n';
+
+	FileLock lock(lockFd, LOCK_EX);
+	refresh();
+	append(out.str());
+	touched.clear();
+}
+
+//
+//	Public interface
+//
+
+PersistentCache::Key
+PersistentCache::key(const Node* input)
+{
+	// Records of other versions of the normalizer are never found
+	// (and they are eventually removed on compaction)
+	return { structuralHash(input) ^ (uint64_t(normalizerVersion) * 0x9e3779b97f4a7c15ull),
+		       dagText(input) };
+}
+
+Node*
+PersistentCache::lookup(const Key& key)
+{
+	lock_guard<std::mutex> guard(mutex);
+	auto it = entries.find(key.hash);
+
+	// Records may have been added by other processes
+	if (it == entries.end()) {
+		FileLock lock(lockFd, LOCK_SH);
+		refresh();
+		it = entries.find(key.hash);
+	}
+
+	// The input is compared to discard hash collisions
+	if (it == entries.end() || it->second.input != key.text) {
+		statistics.misses++;
+		return nullptr;
+	}
+
+	// Corrupt records are counted as misses and dropped, so that they are
+	// replaced by the next store of the formula
+	ostringstream errors;
+	Node* output = parseDag(it->second.output, errors);
+
+	if (!output) {
+		entries.erase(it);
+		statistics.misses++;
+		return nullptr;
+	}
+
+	statistics.hits++;
+	it->second.lastUse = now();
+	touched.push_back(key.hash);
+
+	return output;
+}
+
+void
+PersistentCache::store(const Key& key, const Node* output)
+{
+	const string outText = dagText(output);
+
+	// Names with tabs or line breaks cannot be stored in records
+	if (key.text.find_first_of("\t\n") != string::npos ||
+	    outText.find_first_of("\t\n") != string::npos)
+		return;
+
+	lock_guard<std::mutex> guard(mutex);
+	ostringstream out;
+	const uint64_t stamp = now();
+	out << "R " << hex << key.hash << dec << ' ' << stamp << ' ' << key.text << '\t'
+	    << outText << '\n';
+
+	// Pending uses are written with the new record
+	for (uint64_t touchedKey : touched)
+		out << "T " << hex << touchedKey << dec << ' ' << stamp << '\n';
+
+	FileLock lock(lockFd, LOCK_EX);
+	refresh();
+
+	auto it = entries.find(key.hash);
+
+	if (it != entries.end() && it->second.input == key.text)
+		return;
+
+	if (append(out.str())) {
+		touched.clear();
+		statistics.stored++;
+	}
+
+	if (size_t(readOffset) > maxSize)
+		compact();
+}
+
+PersistentCache::Stats
+PersistentCache::stats()
+{
+	lock_guard<std::mutex> guard(mutex);
+	return statistics;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file cache.hh
+ *
+ * Persistent cache of normal forms shared by different runs.
+ *
+ * The cache is a file of records, each holding the structural hash of an
+ * input formula (combined with the version of the normalizer), the time of
+ * its last use, and the input and normal form in the table format of
+ * dagio.hh. Records are appended as results are computed and the file is
+ * compacted, removing the least recently used records, when it exceeds the
+ * given size. Processes sharing the cache synchronize through an advisory
+ * lock on an auxiliary file (with suffix .lock), and the cache file is
+ * always replaced atomically, so they only read complete records. Threads
+ * of the same process may also share the cache.
+ */
+
+#ifndef CACHE_HH
+#define CACHE_HH
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+#include "tree.hh"
+
+class PersistentCache
+{
+	public:
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t stored = 0;
+		size_t evicted = 0;
+	};
+
+	/**
+	 * Create a cache at the given path with a maximum size in bytes.
+	 */
+	PersistentCache(const std::string& path, size_t maxSize);
+	PersistentCache(const PersistentCache&) = delete;
+	~PersistentCache();
+
+	/**
+	 * Open the cache, creating it if it does not exist.
+	 *
+	 * @return Whether the cache could be opened. Otherwise, the error is
+	 * reported to the standard error.
+	 */
+	bool open();
+
+	/**
+	 * Key of an input formula in the cache (to be calculated before
+	 * normalization, which may modify the input formula).
+	 */
+	struct Key
+	{
+		uint64_t hash;
+		std::string text;
+	};
+
+	static Key key(const Node* input);
+
+	/**
+	 * Look for the normal form of the given formula.
+	 *
+	 * @return The stored normal form (without users) or null if missing.
+	 */
+	Node* lookup(const Key& key);
+
+	/**
+	 * Store the normal form of the given formula.
+	 */
+	void store(const Key& key, const Node* output);
+
+	/**
+	 * Statistics of this process' usage of the cache.
+	 */
+	Stats stats();
+
+	private:
+	struct Entry
+	{
+		std::string input;
+		std::string output;
+		uint64_t lastUse;
+	};
+
+	bool refresh();
+	void compact();
+	void flushTouched();
+	void parseRecords(const std::string& text);
+	bool append(const std::string& text);
+
+	const std::string path;
+	const size_t maxSize;
+	int lockFd = -1;
+
+	// Records read from the file (identified by its inode), where
+	// readOffset is the position up to which it has been read
+	std::unordered_map<uint64_t, Entry> entries;
+	ino_t inode = 0;
+	off_t readOffset = 0;
+
+	// Keys of the records used since the last write to the file
+	std::vector<uint64_t> touched;
+
+	Stats statistics;
+	std::mutex mutex;
+};
+
+#endif // CACHE_HH
@@ -0,0 +1,282 @@
+/**
+ * @file dagio.cc
+ *
+ * Read and write formulae as tables of shared subformulae.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <unordered_map>
+
+#include "dagio.hh"
+
+using namespace std;
+using Op = Node::Op;
+
+//
+//	Names of the operators in the table
+//
+
+const char*
+opName(Op type)
+{
+	switch (type) {
+		case Op::TT:
+			return "tt";
+		case Op::FF:
+			return "ff";
+		case Op::APROP:
+			return "ap";
+		case Op::AND:
+			return "And";
+		case Op::OR:
+			return "Or";
+		case Op::X:
+			return "X";
+		case Op::U:
+			return "U";
+		case Op::W:
+			return "W";
+		case Op::R:
+			return "R";
+		case Op::M:
+			return "M";
+		case Op::GF:
+			return "GF";
+		case Op::FG:
+			return "FG";
+		default:
+			return "unknown";
+	}
+}
+
+bool
+opFromName(const string& name, Op& type)
+{
+	static const Op ops[] = { Op::TT, Op::FF, Op::APROP, Op::AND,
+		                        Op::OR, Op::X,  Op::U,     Op::W,
+		                        Op::R,  Op::M,  Op::GF,    Op::FG };
+
+	for (Op op : ops)
+		if (name == opName(op)) {
+			type = op;
+			return true;
+		}
+
+	return false;
+}
+
+//
+//	Writing
+//
+
+bool
+isPlainName(const string& name)
+{
+	return !name.empty() && all_of(name.begin(), name.end(), [](char c) {
+		return isalnum(static_cast<unsigned char>(c)) || c == '_';
+	});
+}
+
+struct DagPrinter
+{
+	ostream& out;
+	unordered_map<const Node*, size_t> indices;
+	// Structurally equal nodes are written once too, with the text of
+	// the entry (whose arguments are already unique) as their key
+	unordered_map<string, size_t> entries;
+
+	size_t print(const Node* node);
+};
+
+size_t
+DagPrinter::print(const Node* node)
+{
+	auto it = indices.find(node);
+
+	if (it != indices.end())
+		return it->second;
+
+	// Children are written before their parents
+	ostringstream entry;
+	entry << opName(node->type);
+
+	if (is(node, Op::APROP)) {
+		if (isPlainName(node->name))
+			entry << ' ' << node->name;
+		else {
+			entry << " \"";
+
+			for (char c : node->name) {
+				if (c == '"' || c == '\\')
+					entry << '\\';
+				entry << c;
+			}
+
+			entry << '"';
+		}
+	}
+
+	for (const Node* child : node->children)
+		entry << ' ' << print(child);
+
+	auto [eit, inserted] = entries.emplace(entry.str(), entries.size());
+
+	if (inserted) {
+		if (eit->second > 0)
+			out << ';';
+
+		out << eit->first;
+	}
+
+	return indices[node] = eit->second;
+}
+
+void
+printDag(ostream& out, const Node* tree)
+{
+	DagPrinter printer{ out, {}, {} };
+	printer.print(tree);
+}
+
+//
+//	Reading
+//
+
+bool
+parseEntry(const string& entry, size_t index, const vector<Node*>& table,
+           Node*& node, ostream& errors)
+{
+	istringstream in(entry);
+	string opText;
+	Op type;
+
+	if (!(in >> opText) || !opFromName(opText, type)) {
+		errors << "Error: unknown operator '" << opText << "' in entry " << index
+		       << ".\n";
+		return false;
+	}
+
+	if (type == Op::APROP) {
+		string name;
+		in >> ws;
+
+		if (in.peek() == '"') {
+			in.get();
+			char c;
+
+			while (in.get(c) && c != '"') {
+				if (c == '\\' && !in.get(c))
+					break;
+				name += c;
+			}
+
+			if (!in) {
+				errors << "Error: unterminated name of atomic proposition in entry " << index
+				       << ".\n";
+				return false;
+			}
+		} else
+			in >> name;
+
+		if (name.empty()) {
+			errors << "Error: missing name of atomic proposition in entry " << index
+			       << ".\n";
+			return false;
+		}
+
+		if (!(in >> ws).eof()) {
+			errors << "Error: unexpected text after the name of atomic proposition in entry "
+			       << index << ".\n";
+			return false;
+		}
+
+		node = Node::ap(name);
+		return true;
+	}
+
+	vector<Node*> args;
+	size_t arg;
+
+	while (in >> arg) {
+		if (arg >= index) {
+			errors << "Error: entry " << index << " refers to entry " << arg
+			       << ", which is not before it.\n";
+			return false;
+		}
+
+		args.push_back(table[arg]);
+	}
+
+	const int expected = arity(type);
+
+	// Empty conjunctions and disjunctions may appear in the normal forms
+	if (!in.eof() || (expected >= 0 && args.size() != size_t(expected))) {
+		errors << "Error: wrong arguments for " << opText << " in entry " << index
+		       << ".\n";
+		return false;
+	}
+
+	node = Node::make(type, move(args));
+	return true;
+}
+
+/**
+ * Split the table into its entries (semicolons inside quoted names do not
+ * separate entries).
+ */
+vector<string>
+splitEntries(const string& text)
+{
+	vector<string> entries(1);
+	bool quoted = false;
+
+	for (size_t i = 0; i < text.size(); ++i) {
+		const char c = text[i];
+
+		if (c == ';' && !quoted) {
+			entries.emplace_back();
+			continue;
+		}
+
+		entries.back() += c;
+
+		if (c == '"')
+			quoted = !quoted;
+		else if (c == '\\' && quoted && i + 1 < text.size())
+			entries.back() += text[++i];
+	}
+
+	// A trailing semicolon does not start a new entry
+	if (entries.back().empty())
+		entries.pop_back();
+
+	return entries;
+}
+
+Node*
+parseDag(const string& text, ostream& errors)
+{
+	// Every node in the table is kept alive by the table itself, since
+	// the simplifying constructors may try to release their arguments
+	vector<Node*> table;
+	bool ok = true;
+
+	for (const string& entry : splitEntries(text)) {
+		Node* node;
+
+		if (!(ok = parseEntry(entry, table.size(), table, node, errors)))
+			break;
+
+		node->addUser();
+		table.push_back(node);
+	}
+
+	if (ok && table.empty()) {
+		errors << "Error: empty formula table.\n";
+		ok = false;
+	}
+
+	return releaseTable(table, ok ? table.back() : nullptr);
+}
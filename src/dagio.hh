@@ -0,0 +1,48 @@
+/**
+ * @file dagio.hh
+ *
+ * Read and write formulae as tables of shared subformulae.
+ *
+ * A formula is written in a single line as a sequence of entries separated
+ * by semicolons, each describing a node in terms of the previous ones by
+ * their zero-based positions. The last entry is the formula itself. For
+ * example, (a U b) W (c & (a U b)) is written as
+ *
+ *	ap a;ap b;U 0 1;ap c;And 3 2;W 2 4
+ *
+ * Entries are 'tt', 'ff', 'ap <name>', 'X i', 'GF i', 'FG i', 'U i j',
+ * 'W i j', 'R i j', 'M i j', 'And i...' and 'Or i...' (with any number of
+ * arguments, none meaning true and false respectively). Names of atomic
+ * propositions are written between double quotes when they are not
+ * alphanumeric, with a backslash before the double quotes and backslashes
+ * they contain. Each node of the DAG, and even each class of structurally
+ * equal nodes, is written only once.
+ */
+
+#ifndef DAGIO_HH
+#define DAGIO_HH
+
+#include <iostream>
+#include <string>
+
+#include "tree.hh"
+
+/**
+ * Name of an operator in the table (like And or GF).
+ */
+const char* opName(Node::Op type);
+
+/**
+ * Write a formula as a table of shared subformulae.
+ */
+void printDag(std::ostream& out, const Node* tree);
+
+/**
+ * Read a formula written as a table of shared subformulae.
+ *
+ * @return The formula or a null pointer if the text is malformed, in which
+ * case the error is reported to the given stream.
+ */
+Node* parseDag(const std::string& text, std::ostream& errors = std::cerr);
+
+#endif // DAGIO_HH
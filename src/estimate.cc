@@ -0,0 +1,229 @@
+/**
+ * @file estimate.cc
+ *
+ * Cheap estimation of the cost of normalizing a formula.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "estimate.hh"
+
+using namespace std;
+using Op = Node::Op;
+
+// Context of a node in the formula (as flags)
+enum Context : unsigned
+{
+	IN_WR = 1,       // Below W/R (but not below GF/FG)
+	IN_TEMPORAL = 2, // Below some temporal operator
+	IN_GF = 4,       // Below GF (but not below a nested GF/FG)
+	IN_FG = 8,       // Below FG (but not below a nested GF/FG)
+};
+
+// Nodes added by each rule application besides the copies of the rewritten
+// subformula (calibrated on the sample formulae of the repository)
+constexpr double ruleOverhead = 8;
+
+/**
+ * Argument of the GF/FG introduced by the rules rewriting a U/M or W/R node.
+ * The rules rewrite at once all the U/M (or W/R) nodes with the same argument,
+ * so they are a single trigger.
+ */
+const Node*
+ruleArgument(const Node* node)
+{
+	return is(node, Op::U) || is(node, Op::R) ? node->children[1] : node->children[0];
+}
+
+/**
+ * Distinct triggers of the rules in a component (the U/M and W/R nodes are
+ * identified by their rule arguments).
+ */
+struct Triggers
+{
+	unordered_set<const Node*> wu, gf, fix;
+	// Number of distinct U/M below each W/R node (outside GF/FG)
+	unordered_map<const Node*, size_t> nested;
+	// Contexts in which each node has been visited (as a bit mask)
+	unordered_map<const Node*, unsigned> visited;
+};
+
+/**
+ * Collect the rule arguments of the U/M nodes below a node that are not below
+ * GF/FG.
+ */
+void
+collectU(const Node* node, unordered_set<const Node*>& found, unordered_set<const Node*>& seen)
+{
+	if (node->isUnique() || is(node, Op::GF) || is(node, Op::FG) || !seen.insert(node).second)
+		return;
+
+	if (is(node, Op::U) || is(node, Op::M))
+		found.insert(ruleArgument(node));
+
+	for (const Node* child : node->children)
+		collectU(child, found, seen);
+}
+
+/**
+ * Collect the subformulae triggering the rules in the given context (each
+ * node is visited once per context).
+ */
+void
+collectTriggers(const Node* node, unsigned context, Triggers& triggers)
+{
+	if (node->isUnique())
+		return;
+
+	unsigned& visited = triggers.visited[node];
+
+	if (visited & (1u << context))
+		return;
+
+	visited |= 1u << context;
+	unsigned childContext = context | IN_TEMPORAL;
+
+	switch (node->type) {
+		case Op::AND:
+		case Op::OR:
+			childContext = context;
+			break;
+
+		case Op::X:
+			break;
+
+		case Op::U:
+		case Op::M:
+			if (context & IN_WR)
+				triggers.wu.insert(ruleArgument(node));
+			if (context & IN_FG)
+				triggers.fix.insert(ruleArgument(node));
+			break;
+
+		case Op::W:
+		case Op::R:
+			if (context & IN_GF)
+				triggers.fix.insert(ruleArgument(node));
+
+			// Outside GF/FG, the U/M below are rewritten by rules 1 and 2 on this node
+			if (!(context & (IN_GF | IN_FG)) && triggers.nested.count(node) == 0) {
+				unordered_set<const Node*> found, seen;
+				collectU(node, found, seen);
+				triggers.nested[node] = found.size();
+			}
+
+			childContext |= IN_WR;
+			break;
+
+		case Op::GF:
+		case Op::FG:
+			if (context & IN_TEMPORAL)
+				triggers.gf.insert(node);
+			if (context & IN_GF)
+				triggers.fix.insert(node);
+
+			childContext = IN_TEMPORAL | (is(node, Op::GF) ? IN_GF : IN_FG);
+			break;
+
+		default:
+			break;
+	}
+
+	for (const Node* child : node->children)
+		collectTriggers(child, childContext, triggers);
+}
+
+/**
+ * Estimator of the cost of the components of a formula (its maximal
+ * subformulae that are not conjunctions or disjunctions), which are
+ * normalized independently by every step.
+ */
+struct Estimator
+{
+	CostEstimate total;
+	unordered_map<const Node*, double> sizes;
+	// Estimated output size and work of the nodes of the Boolean structure
+	unordered_map<const Node*, pair<double, double>> costs;
+
+	/**
+	 * Tree size of a formula (memoized on its DAG).
+	 */
+	double treeSize(const Node* node);
+
+	/**
+	 * Estimated output size and work of a node of the Boolean structure.
+	 */
+	pair<double, double> cost(const Node* node);
+};
+
+double
+Estimator::treeSize(const Node* node)
+{
+	if (node->isConstant())
+		return 0;
+
+	if (auto it = sizes.find(node); it != sizes.end())
+		return it->second;
+
+	double size = 1;
+
+	for (const Node* child : node->children)
+		size += treeSize(child);
+
+	return sizes[node] = size;
+}
+
+pair<double, double>
+Estimator::cost(const Node* node)
+{
+	if (auto it = costs.find(node); it != costs.end())
+		return it->second;
+
+	pair<double, double> result;
+
+	if (is(node, Op::AND) || is(node, Op::OR)) {
+		result = { 1, 1 };
+
+		for (const Node* child : node->children) {
+			auto [size, work] = cost(child);
+			result.first += size;
+			result.second += work;
+		}
+	} else {
+		Triggers triggers;
+		collectTriggers(node, 0, triggers);
+
+		const double wu = triggers.wu.size();
+		const double others = triggers.gf.size() + triggers.fix.size();
+		double nested = 0;
+
+		for (auto [wr, count] : triggers.nested)
+			nested += count;
+
+		total.wuTriggers += wu;
+		total.gfTriggers += triggers.gf.size();
+		total.fixTriggers += triggers.fix.size();
+
+		// The bound of estimate.hh, whose logarithm is bounded to keep the
+		// estimates finite
+		const double factor = exp2(min(wu + nested + others, 1000.0));
+		const double size = factor * (treeSize(node) + ruleOverhead) - ruleOverhead;
+
+		result = { size, size * (1 + wu + others) };
+	}
+
+	return costs[node] = result;
+}
+
+CostEstimate
+estimateCost(const Node* formula)
+{
+	Estimator estimator;
+	tie(estimator.total.outputSize, estimator.total.work) = estimator.cost(formula);
+	estimator.total.size = estimator.treeSize(formula);
+
+	return estimator.total;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file estimate.hh
+ *
+ * Cheap estimation of the cost of normalizing a formula.
+ *
+ * The normalization only grows a formula when it applies its rules, and
+ * each rule application copies the rewritten subformula a few times. Every
+ * step normalizes the components of the top-level Boolean structure (its
+ * maximal subformulae that are not conjunctions or disjunctions) on their
+ * own, and the estimator collects in each of them the distinct subformulae
+ * (on the DAG) that trigger the rules:
+ *
+ *  - U/M below W/R (rules 1 and 2),
+ *  - GF/FG below some temporal operator (rule 3),
+ *  - W/R and GF/FG below GF (rule 4) and U/M below FG (rule 5),
+ *
+ * where nested operators are counted too, since the rules expose them as
+ * new triggers once the outer ones are rewritten, and GF/FG delimit the
+ * scope of the first and last kinds (which are handled separately inside
+ * them). The U/M and W/R nodes rewritten at once by a rule application (those
+ * with the same argument for the new GF/FG) are a single trigger. The size
+ * of each component is bounded by assuming that each trigger doubles it, and
+ * so does each W/R node again for each distinct U/M below it (rules 1 and 2
+ * rewrite the latter again on every W/R node above). This bound holds for
+ * all the sample formulae of the repository, where it is within a factor of
+ * two for half of the formulae of tlsf21_300.spot, but it is not exact: the
+ * simplifications applied when building the nodes often make the normal
+ * form much smaller.
+ */
+
+#ifndef ESTIMATE_HH
+#define ESTIMATE_HH
+
+#include <cstddef>
+
+#include "tree.hh"
+
+struct CostEstimate
+{
+	double size = 0;       // Tree size of the input
+	double wuTriggers = 0; // Distinct triggers of rules 1 and 2
+	double gfTriggers = 0; // Distinct triggers of rule 3 (in removeGF)
+	double fixTriggers = 0; // Distinct triggers of rules 4 and 5 (in fixGF)
+
+	double outputSize = 0; // Upper estimate of the tree size of the normal form
+	double work = 0;       // Estimated number of nodes visited and built
+
+	double triggers() const { return wuTriggers + gfTriggers + fixTriggers; }
+};
+
+/**
+ * Estimate the cost of normalizing a formula (in time linear in the DAG of
+ * each component times its number of W/R nodes).
+ */
+CostEstimate estimateCost(const Node* formula);
+
+#endif // ESTIMATE_HH
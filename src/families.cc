@@ -0,0 +1,223 @@
+/**
+ * @file families.cc
+ *
+ * Parametric families of formulae to measure how the normalizer scales.
+ */
+
+#include <cmath>
+#include <cstdio>
+
+#include "families.hh"
+
+using namespace std;
+
+//
+//	Generators
+//
+
+/**
+ * Alternating W and U operators, (((a0 U b1) W a1) U b2) W a2...
+ * (like hard_formula in scripts/test_generate.py).
+ */
+string
+hardFormula(unsigned size)
+{
+	string formula = "a0";
+
+	for (unsigned i = 1; i <= size; ++i)
+		formula = "((" + formula + ") U b" + to_string(i) + ") W a" + to_string(i);
+
+	return formula;
+}
+
+/**
+ * A single W on top and U below, ((a0 U a1) U a2...) W b
+ * (like uw_formula in scripts/test_generate.py).
+ */
+string
+uwFormula(unsigned size)
+{
+	string formula = "a0";
+
+	for (unsigned i = 1; i <= size; ++i)
+		formula = "(" + formula + ") U a" + to_string(i);
+
+	return "(" + formula + ") W b";
+}
+
+/**
+ * Nested GF and FG operators with U and W below them,
+ * GF(a1 U FG(a2 W GF(a3 U ...))).
+ */
+string
+nestedGFFormula(unsigned size)
+{
+	string formula = "a0";
+
+	for (unsigned i = size; i >= 1; --i)
+		formula = (i % 2 ? "GF(a" : "FG(a") + to_string(i) + (i % 2 ? " U (" : " W (") +
+		          formula + "))";
+
+	return formula;
+}
+
+/**
+ * Conjunction of response patterns with a waiting condition,
+ * G(!r1 | (w1 U g1)) & G(!r2 | (w2 U g2)) & ...
+ */
+string
+responseFormula(unsigned size)
+{
+	string formula;
+
+	for (unsigned i = 1; i <= size; ++i) {
+		const string index = to_string(i);
+		formula += (i > 1 ? " & " : "") + ("G(!r" + index + " | (w" + index + " U g" + index + "))");
+	}
+
+	return formula;
+}
+
+/**
+ * An until below a chain of next operators below a globally,
+ * G(a | XX...X(b U c)).
+ */
+string
+nextChainFormula(unsigned size)
+{
+	string nexts;
+
+	for (unsigned i = 0; i < size; ++i)
+		nexts += "X";
+
+	return "G(a | " + nexts + "(b U c))";
+}
+
+/**
+ * Fairness conditions sharing an alternative below an eventually,
+ * F((GF p1 | a) & (GF p2 | a) & ...), whose case splits lead to few
+ * distinct cofactors.
+ */
+string
+fairnessFormula(unsigned size)
+{
+	string formula;
+
+	for (unsigned i = 1; i <= size; ++i)
+		formula += (i > 1 ? " & " : "") + ("(GF p" + to_string(i) + " | a)");
+
+	return "F(" + formula + ")";
+}
+
+const vector<Family> families = {
+	{ "hard", "alternating W and U, (((a0 U b1) W a1) U b2) W a2...", hardFormula },
+	{ "uw", "U below a single W, ((a0 U a1) U a2...) W b", uwFormula },
+	{ "nested-gf", "nested GF and FG, GF(a1 U FG(a2 W ...))", nestedGFFormula },
+	{ "response", "conjunction of G(!ri | (wi U gi))", responseFormula },
+	{ "next-chain", "G(a | X...X(b U c))", nextChainFormula },
+	{ "fairness", "shared fairness alternatives, F((GF pi | a) & ...)", fairnessFormula },
+};
+
+const Family*
+findFamily(const string& name)
+{
+	for (const Family& family : families)
+		if (name == family.name)
+			return &family;
+
+	return nullptr;
+}
+
+//
+//	Growth models
+//
+
+/**
+ * Least squares fit of y = a + b x.
+ *
+ * @return The slope b, with the coefficient of determination in r2.
+ */
+double
+linearFit(const vector<double>& xs, const vector<double>& ys, double& r2)
+{
+	const double n = xs.size();
+	double sx = 0, sy = 0, sxx = 0, sxy = 0, syy = 0;
+
+	for (size_t i = 0; i < xs.size(); ++i) {
+		sx += xs[i];
+		sy += ys[i];
+		sxx += xs[i] * xs[i];
+		sxy += xs[i] * ys[i];
+		syy += ys[i] * ys[i];
+	}
+
+	const double vx = n * sxx - sx * sx, vy = n * syy - sy * sy, cov = n * sxy - sx * sy;
+
+	// A constant measure is perfectly fitted by a null slope
+	r2 = vx > 0 && vy > 0 ? cov * cov / (vx * vy) : 1;
+
+	return vx > 0 ? cov / vx : 0;
+}
+
+const char*
+GrowthFit::modelName(Model model)
+{
+	switch (model) {
+		case POLYNOMIAL:
+			return "polynomial";
+		case EXPONENTIAL:
+			return "exponential";
+		default:
+			return "unknown";
+	}
+}
+
+GrowthFit
+fitGrowth(const vector<unsigned>& sizes, const vector<double>& values)
+{
+	vector<double> ns, logNs, logValues;
+
+	for (size_t i = 0; i < sizes.size(); ++i)
+		if (values[i] > 0) {
+			ns.push_back(sizes[i]);
+			logNs.push_back(log(sizes[i]));
+			logValues.push_back(log(values[i]));
+		}
+
+	GrowthFit fit;
+
+	if (ns.size() < 3)
+		return fit;
+
+	double polyR2, expR2;
+	const double exponent = linearFit(logNs, logValues, polyR2);
+	const double logBase = linearFit(ns, logValues, expR2);
+
+	// Slow exponentials are indistinguishable from polynomials (or from linear
+	// functions with a large constant term) for the sizes being measured
+	if (expR2 > polyR2 && exp(logBase) > 1.1)
+		fit = { GrowthFit::EXPONENTIAL, exp(logBase), expR2 };
+	else
+		fit = { GrowthFit::POLYNOMIAL, exponent, polyR2 };
+
+	return fit;
+}
+
+string
+describeGrowth(const GrowthFit& fit)
+{
+	char buffer[64];
+
+	switch (fit.model) {
+		case GrowthFit::POLYNOMIAL:
+			snprintf(buffer, sizeof(buffer), "n^%.2f (r2 %.3f)", fit.rate, fit.r2);
+			break;
+		case GrowthFit::EXPONENTIAL:
+			snprintf(buffer, sizeof(buffer), "%.2f^n (r2 %.3f)", fit.rate, fit.r2);
+			break;
+		default:
+			return "unknown";
+	}
+
+	return buffer;
+}
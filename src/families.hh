@@ -0,0 +1,65 @@
+/**
+ * @file families.hh
+ *
+ * Parametric families of formulae to measure how the normalizer scales.
+ */
+
+#ifndef FAMILIES_HH
+#define FAMILIES_HH
+
+#include <string>
+#include <vector>
+
+struct Family
+{
+	const char* name;
+	const char* description;
+	/**
+	 * Formula of the family for the given size parameter (from 1) in the
+	 * Spot syntax.
+	 */
+	std::string (*generate)(unsigned size);
+};
+
+/**
+ * All the available families.
+ */
+extern const std::vector<Family> families;
+
+/**
+ * Find a family by its name (or null if there is none).
+ */
+const Family* findFamily(const std::string& name);
+
+/**
+ * Model of the growth of a measure with the size parameter, fitted by least
+ * squares on the logarithm of the measure.
+ */
+struct GrowthFit
+{
+	enum Model
+	{
+		UNKNOWN,     // Too few points to fit a model
+		POLYNOMIAL,  // c * n^rate
+		EXPONENTIAL, // c * rate^n
+	};
+
+	Model model = UNKNOWN;
+	double rate = 0;
+	double r2 = 0; // Coefficient of determination of the fit
+
+	static const char* modelName(Model model);
+};
+
+/**
+ * Fit the better of the polynomial and exponential models to the given
+ * measures (only positive values are considered).
+ */
+GrowthFit fitGrowth(const std::vector<unsigned>& sizes, const std::vector<double>& values);
+
+/**
+ * Describe a fitted growth in text, like n^2.00 or 1.50^n.
+ */
+std::string describeGrowth(const GrowthFit& fit);
+
+#endif // FAMILIES_HH
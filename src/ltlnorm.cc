@@ -0,0 +1,373 @@
+/**
+ * @file ltlnorm.cc
+ *
+ * C interface of the ltlnorm library.
+ */
+
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+#include <spot/tl/formula.hh>
+
+#include "estimate.hh"
+#include "ltlnorm.h"
+#include "pipeline.hh"
+#include "session.hh"
+#include "threadpool.hh"
+
+using namespace std;
+
+struct ltlnorm_context
+{
+	Format input;
+	Format output;
+	unique_ptr<PersistentCache> cache;
+	unique_ptr<RenamingCache> renaming;
+	unique_ptr<ThreadPool> pool;
+	double maxWork;
+	unsigned simplify;
+	string lastError;
+
+	/**
+	 * Read a formula given as text and simplify it.
+	 *
+	 * @return The formula or nullptr if it is malformed. Then, the error
+	 * is kept as the last one.
+	 */
+	Node* read(const char* formula);
+
+	/**
+	 * Check that the estimated cost of normalizing a formula is within the
+	 * limit. Otherwise, the error is kept as the last one.
+	 */
+	bool admit(const Node* formula);
+
+	/**
+	 * Normalize a formula with the caches and threads of the context.
+	 */
+	Node* normalize(Node* formula);
+
+	/**
+	 * Normalize a formula given as text.
+	 *
+	 * @return LTLNORM_OK, LTLNORM_BAD_INPUT or LTLNORM_TOO_EXPENSIVE.
+	 * Errors are kept as the last one.
+	 */
+	ltlnorm_status normalize(const char* formula, string& result);
+};
+
+struct ltlnorm_session
+{
+	ltlnorm_context* context;
+	Session session;
+};
+
+Node*
+ltlnorm_context::read(const char* formula)
+{
+	ostringstream errors;
+	Node* node = readFormula(formula, input, errors);
+
+	if (!node) {
+		lastError = errors.str();
+
+		while (!lastError.empty() && lastError.back() == '\n')
+			lastError.pop_back();
+
+		return nullptr;
+	}
+
+	if (simplify == 0)
+		return node;
+
+	NodeRef input(node);
+	NodeRef simplified(simplifyFormula(node, simplify));
+	input = NodeRef();
+
+	return simplified.detach();
+}
+
+bool
+ltlnorm_context::admit(const Node* formula)
+{
+	if (maxWork > 0) {
+		const CostEstimate estimate = estimateCost(formula);
+
+		if (estimate.work > maxWork) {
+			ostringstream message;
+			message << "estimated work " << estimate.work << " exceeds the limit";
+			lastError = message.str();
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+Node*
+ltlnorm_context::normalize(Node* formula)
+{
+	return normalizeCached(formula, cache.get(), pool.get(), renaming.get());
+}
+
+ltlnorm_status
+ltlnorm_context::normalize(const char* formula, string& result)
+{
+	NodeRef input(read(formula));
+
+	if (!input)
+		return LTLNORM_BAD_INPUT;
+
+	if (!admit(input.get()))
+		return LTLNORM_TOO_EXPENSIVE;
+
+	NodeRef normal(normalize(input.get()));
+	result = writeFormula(normal.get(), output);
+
+	return LTLNORM_OK;
+}
+
+inline Format
+toFormat(ltlnorm_format format)
+{
+	return format == LTLNORM_DAG ? Format::DAG : Format::SPOT;
+}
+
+/**
+ * Copy a string into a buffer of the caller.
+ */
+inline ltlnorm_status
+copyResult(const string& result, char* buffer, size_t size, size_t* length)
+{
+	if (result.size() >= size) {
+		if (length)
+			*length = result.size() + 1;
+		return LTLNORM_TOO_SMALL;
+	}
+
+	memcpy(buffer, result.c_str(), result.size() + 1);
+
+	if (length)
+		*length = result.size();
+
+	return LTLNORM_OK;
+}
+
+//
+//	Public interface
+//
+
+void
+ltlnorm_default_options(ltlnorm_options* options)
+{
+	options->input = LTLNORM_SPOT;
+	options->output = LTLNORM_SPOT;
+	options->cache_path = nullptr;
+	options->cache_size = 64 << 20;
+	options->rename_cache = 0;
+	options->threads = 1;
+	options->max_work = 0;
+	options->simplify = 0;
+}
+
+ltlnorm_context*
+ltlnorm_create(const ltlnorm_options* options)
+{
+	ltlnorm_options defaults;
+
+	if (!options) {
+		ltlnorm_default_options(&defaults);
+		options = &defaults;
+	}
+
+	auto context = make_unique<ltlnorm_context>();
+	context->input = toFormat(options->input);
+	context->output = toFormat(options->output);
+	context->maxWork = options->max_work;
+	context->simplify = options->simplify;
+
+	if (options->rename_cache)
+		context->renaming = make_unique<RenamingCache>();
+
+	if (options->threads != 1)
+		context->pool = make_unique<ThreadPool>(options->threads);
+
+	if (options->cache_path) {
+		context->cache = make_unique<PersistentCache>(options->cache_path, options->cache_size);
+
+		if (!context->cache->open())
+			return nullptr;
+	}
+
+	return context.release();
+}
+
+void
+ltlnorm_destroy(ltlnorm_context* context)
+{
+	delete context;
+}
+
+ltlnorm_status
+ltlnorm_normalize(ltlnorm_context* context, const char* formula, char* buffer, size_t size,
+                  size_t* length)
+{
+	if (!context || !formula || (!buffer && size > 0))
+		return LTLNORM_BAD_ARGUMENT;
+
+	string result;
+	const ltlnorm_status status = context->normalize(formula, result);
+
+	if (status != LTLNORM_OK)
+		return status;
+
+	context->lastError.clear();
+	return copyResult(result, buffer, size, length);
+}
+
+size_t
+ltlnorm_normalize_batch(ltlnorm_context* context, const char* const* formulae, size_t count,
+                        char* buffer, size_t size, size_t* offsets, ltlnorm_status* statuses)
+{
+	if (!context || !formulae || !offsets || (!buffer && size > 0))
+		return 0;
+
+	context->lastError.clear();
+
+	size_t used = 0;
+	string result;
+
+	for (size_t i = 0; i < count; ++i) {
+		ltlnorm_status status = LTLNORM_OK;
+
+		if (!formulae[i]) {
+			result.clear();
+			status = LTLNORM_BAD_ARGUMENT;
+		} else if ((status = context->normalize(formulae[i], result)) != LTLNORM_OK) {
+			result.clear();
+			// The errors of a batch are not kept (as documented in ltlnorm.h)
+			context->lastError.clear();
+		}
+
+		// The batch stops at the first result that does not fit
+		if (copyResult(result, buffer + used, size - used, nullptr) != LTLNORM_OK) {
+			if (statuses)
+				statuses[i] = LTLNORM_TOO_SMALL;
+			return i;
+		}
+
+		offsets[i] = used;
+		used += result.size() + 1;
+
+		if (statuses)
+			statuses[i] = status;
+	}
+
+	return count;
+}
+
+ltlnorm_status
+ltlnorm_estimate(ltlnorm_context* context, const char* formula, double* size, double* work)
+{
+	if (!context || !formula)
+		return LTLNORM_BAD_ARGUMENT;
+
+	NodeRef input(context->read(formula));
+
+	if (!input)
+		return LTLNORM_BAD_INPUT;
+
+	const CostEstimate estimate = estimateCost(input.get());
+
+	if (size)
+		*size = estimate.outputSize;
+	if (work)
+		*work = estimate.work;
+
+	context->lastError.clear();
+	return LTLNORM_OK;
+}
+
+ltlnorm_session*
+ltlnorm_session_create(ltlnorm_context* context)
+{
+	if (!context)
+		return nullptr;
+
+	return new ltlnorm_session{ context,
+		                          Session([context](Node* formula) {
+			                          return context->normalize(formula);
+		                          }) };
+}
+
+void
+ltlnorm_session_destroy(ltlnorm_session* session)
+{
+	delete session;
+}
+
+ltlnorm_status
+ltlnorm_session_set(ltlnorm_session* session, const char* name, const char* formula)
+{
+	if (!session || !name || !formula)
+		return LTLNORM_BAD_ARGUMENT;
+
+	ltlnorm_context* context = session->context;
+	NodeRef input(context->read(formula));
+
+	if (!input)
+		return LTLNORM_BAD_INPUT;
+
+	if (!context->admit(input.get()))
+		return LTLNORM_TOO_EXPENSIVE;
+
+	session->session.set(name, input.get());
+	context->lastError.clear();
+
+	return LTLNORM_OK;
+}
+
+ltlnorm_status
+ltlnorm_session_remove(ltlnorm_session* session, const char* name)
+{
+	if (!session || !name || !session->session.remove(name))
+		return LTLNORM_BAD_ARGUMENT;
+
+	return LTLNORM_OK;
+}
+
+ltlnorm_status
+ltlnorm_session_normal_form(ltlnorm_session* session, char* buffer, size_t size,
+                            size_t* length)
+{
+	if (!session || (!buffer && size > 0))
+		return LTLNORM_BAD_ARGUMENT;
+
+	const string result =
+	  writeFormula(session->session.normalForm(), session->context->output);
+
+	return copyResult(result, buffer, size, length);
+}
+
+const char*
+ltlnorm_last_error(const ltlnorm_context* context)
+{
+	return context ? context->lastError.c_str() : "";
+}
+
+spot::formula
+ltlnorm_normalize_formula(ltlnorm_context* context, const spot::formula& formula)
+{
+	NodeRef input(readFormula(formula));
+
+	if (context)
+		input = NodeRef(simplifyFormula(input.get(), context->simplify));
+
+	NodeRef normal(context ? normalizeCached(input.get(), context->cache.get(), context->pool.get(),
+	                                         context->renaming.get())
+	                       : normalizeCached(input.get(), nullptr));
+
+	return writeFormula(normal.get());
+}
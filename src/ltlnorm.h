@@ -0,0 +1,189 @@
+/**
+ * @file ltlnorm.h
+ *
+ * C interface of the ltlnorm library.
+ *
+ * Formulae are normalized within a context, which holds the formats of the
+ * input and output formulae, optional caches of normal forms, and the
+ * message of the last error. A context must not be used by several
+ * threads at the same time, but different contexts can be used concurrently.
+ *
+ * Results are written to buffers owned by the caller as null-terminated
+ * strings. If a buffer is too small, LTLNORM_TOO_SMALL is returned and the
+ * required size (including the null terminator) is stored in the length
+ * argument, so that the call can be repeated with a larger buffer.
+ */
+
+#ifndef LTLNORM_H
+#define LTLNORM_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Version of the interface (increased on incompatible changes).
+ */
+#define LTLNORM_API_VERSION 4
+
+typedef struct ltlnorm_context ltlnorm_context;
+typedef struct ltlnorm_session ltlnorm_session;
+
+typedef enum ltlnorm_format
+{
+	LTLNORM_SPOT, /* Spot's infix syntax */
+	LTLNORM_DAG   /* Table of shared subformulae */
+} ltlnorm_format;
+
+typedef enum ltlnorm_status
+{
+	LTLNORM_OK,         /* The normal form has been written */
+	LTLNORM_BAD_INPUT,  /* The formula is malformed */
+	LTLNORM_TOO_SMALL,  /* The buffer is too small for the result */
+	LTLNORM_BAD_ARGUMENT,
+	LTLNORM_TOO_EXPENSIVE /* The estimated cost exceeds the limit */
+} ltlnorm_status;
+
+typedef struct ltlnorm_options
+{
+	ltlnorm_format input;
+	ltlnorm_format output;
+	const char* cache_path; /* Persistent cache of normal forms (or NULL) */
+	size_t cache_size;      /* Maximum size of the cache in bytes */
+	int rename_cache;       /* Whether to reuse normal forms in memory up to
+	                           the renaming of atomic propositions */
+	unsigned threads;       /* Threads to normalize the independent conjuncts
+	                           and disjuncts of large formulae (1 for none,
+	                           0 for all available) */
+	double max_work;        /* Formulae whose estimated cost exceeds this
+	                           are not normalized (0 for no limit) */
+	unsigned simplify;      /* Level of simplification of the formulae read
+	                           (0 for none, up to 4, as in ltlnorm) */
+} ltlnorm_options;
+
+/**
+ * Default options (Spot format for input and output, without caches,
+ * sequential normalization, no limit on the cost, and no simplification).
+ */
+void ltlnorm_default_options(ltlnorm_options* options);
+
+/**
+ * Create a normalization context.
+ *
+ * @param options Options of the context (or NULL for the default ones).
+ * @return The context or NULL if the cache cannot be opened.
+ */
+ltlnorm_context* ltlnorm_create(const ltlnorm_options* options);
+
+/**
+ * Destroy a normalization context.
+ */
+void ltlnorm_destroy(ltlnorm_context* context);
+
+/**
+ * Normalize a formula.
+ *
+ * @param formula Formula in the input format of the context.
+ * @param buffer Buffer where the normal form is written.
+ * @param size Size of the buffer.
+ * @param length Where the length of the normal form is stored (without
+ * the null terminator), or the required size if the buffer is too small.
+ * It can be NULL.
+ */
+ltlnorm_status ltlnorm_normalize(ltlnorm_context* context, const char* formula,
+                                 char* buffer, size_t size, size_t* length);
+
+/**
+ * Normalize a batch of formulae.
+ *
+ * The normal forms are written one after the other in the buffer, each
+ * terminated by a null character, and the offset of each one is stored in
+ * the offsets array. The status of each formula is stored in the statuses
+ * array (which can be NULL), and the normal form of malformed formulae and
+ * of those too expensive is an empty string (their errors are not kept).
+ *
+ * @return The number of formulae whose normal forms have been written,
+ * which is less than count if the buffer is too small. In that case,
+ * the status of the first formula not written is LTLNORM_TOO_SMALL.
+ */
+size_t ltlnorm_normalize_batch(ltlnorm_context* context, const char* const* formulae,
+                               size_t count, char* buffer, size_t size, size_t* offsets,
+                               ltlnorm_status* statuses);
+
+/**
+ * Estimate the cost of normalizing a formula without normalizing it.
+ *
+ * The estimate takes time linear in the size of the formula. It is a rough
+ * upper bound meant to rank formulae and to detect those that may blow up,
+ * not a prediction. The formula is simplified first as when normalized.
+ *
+ * @param formula Formula in the input format of the context.
+ * @param size Where the estimated size of the normal form is stored (as
+ * a tree). It can be NULL.
+ * @param work Where the estimated number of nodes visited and built by the
+ * normalization is stored. It can be NULL.
+ */
+ltlnorm_status ltlnorm_estimate(ltlnorm_context* context, const char* formula,
+                                double* size, double* work);
+
+/**
+ * Create a session holding a specification as a conjunction of named
+ * formulae, which is renormalized incrementally when they are edited.
+ *
+ * The session uses the formats, caches and threads of the context, where
+ * its errors are kept, so the context must outlive it and they must not
+ * be used at the same time by different threads.
+ *
+ * @return The session (whose specification is initially true).
+ */
+ltlnorm_session* ltlnorm_session_create(ltlnorm_context* context);
+
+/**
+ * Destroy a session.
+ */
+void ltlnorm_session_destroy(ltlnorm_session* session);
+
+/**
+ * Add a conjunct to the specification or replace the one with the same
+ * name. Only this formula is normalized.
+ */
+ltlnorm_status ltlnorm_session_set(ltlnorm_session* session, const char* name,
+                                   const char* formula);
+
+/**
+ * Remove a conjunct from the specification.
+ *
+ * @return LTLNORM_BAD_ARGUMENT if there is no conjunct with that name.
+ */
+ltlnorm_status ltlnorm_session_remove(ltlnorm_session* session, const char* name);
+
+/**
+ * Write the normal form of the specification (like ltlnorm_normalize).
+ */
+ltlnorm_status ltlnorm_session_normal_form(ltlnorm_session* session, char* buffer,
+                                           size_t size, size_t* length);
+
+/**
+ * Message of the last error in the context (or an empty string).
+ */
+const char* ltlnorm_last_error(const ltlnorm_context* context);
+
+#ifdef __cplusplus
+} // extern "C"
+
+namespace spot {
+class formula;
+}
+
+/**
+ * Normalize a Spot formula (in C++ only).
+ *
+ * The formats of the context and its limit on the cost are not used.
+ */
+spot::formula ltlnorm_normalize_formula(ltlnorm_context* context, const spot::formula& formula);
+
+#endif
+
+#endif /* LTLNORM_H */
@@ -2,14 +2,25 @@
  * @file main.cc
  */
 
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <unordered_set>
 
-#include <spot/tl/nenoform.hh>
-#include <spot/tl/parse.hh>
+#include <unistd.h>
 
-#include "normalizer.hh"
-#include "tfspot.hh"
+#include "binio.hh"
+#include "estimate.hh"
+#include "pipeline.hh"
+#include "server.hh"
+#include "session.hh"
+#include "stats.hh"
+#include "threadpool.hh"
+#include "trace.hh"
 
 using namespace std;
 using Op = Node::Op;
@@ -71,43 +82,549 @@ printNode(const Node* node, bool color = true)
 }
 
 //
-//	Main loop reading formulae in the Spot format and printing
-//	their normal forms (line by line)
+//	Command-line options
 //
 
+struct Options
+{
+	Format input = Format::SPOT;
+	Format output = Format::SPOT;
+	Engine engine = Engine::NODE; // Normalization engine
+	bool sizes = false;   // Report the size of the input and output formulae
+	bool convert = false; // Only convert between formats without normalizing
+	unsigned simplify = 0; // Level of simplification before normalizing
+	StatsFormat stats = StatsFormat::NONE; // Report statistics of each formula
+	bool checkMemory = false; // Report memory usage and leaked nodes
+
+	const char* tracePath = nullptr; // Write a timeline in Chrome's format
+	unsigned traceDepth = 0;         // Maximum depth of the spans (0 for all)
+	double traceSample = 1;          // Fraction of the rule spans traced
+
+	const char* cachePath = nullptr; // Persistent cache of normal forms
+	size_t cacheSize = 64 << 20;     // Maximum size of the cache in bytes
+	bool cacheStats = false;         // Report the usage of the cache
+	bool renameCache = false;        // Cache normal forms up to renaming
+
+	bool session = false;             // Edit a specification conjunct by conjunct
+	const char* serverPath = nullptr; // Serve requests on a Unix socket
+	unsigned threads = 0;             // Threads of the server
+	double maxWork = 0;               // Limit on the estimated cost of requests
+
+	// Threads to normalize the components of large formulae (1 for none,
+	// 0 for all available, or those of the server)
+	unsigned parallel = 1;
+};
+
 void
-normalizeLoop()
+usage(const char* progname)
 {
-	string line;
-	getline(cin, line);
+	cerr << "Usage: " << progname << " [options]\n\n"
+	     << "Read LTL formulae line by line and print their normal forms.\n\n"
+	     << "Options:\n"
+	     << "  --input=FORMAT   format of the input formulae (spot by default)\n"
+	     << "  --output=FORMAT  format of the output formulae (spot by default)\n"
+	     << "  --convert        only convert the formulae between formats\n"
+	     << "  --engine=NAME    normalization engine: node (rewriting of the DAG\n"
+	     << "                   of nodes, by default) or spot (rewriting of Spot's\n"
+	     << "                   formulae, only for formulae in Spot's syntax one\n"
+	     << "                   by one, without simplification, memory checks,\n"
+	     << "                   caches, sessions, servers or parallelism)\n"
+	     << "  --simplify=N     simplify the formulae before normalizing them\n"
+	     << "                   (0 for none, 1 by rewriting, 2 to 4 also with\n"
+	     << "                   Spot's simplifier at its levels 1 to 3)\n"
+	     << "  --sizes          report the tree and DAG sizes of the input and\n"
+	     << "                   output formulae and the length of the output\n"
+	     << "                   text in the standard error (and the triggers\n"
+	     << "                   of the rules removed by the simplification)\n"
+	     << "  --stats=FORMAT   report phase timings, rule applications and node\n"
+	     << "                   counts of each formula in the standard error,\n"
+	     << "                   as lines in json or csv format\n"
+	     << "  --check-memory   report the memory used by the nodes of each\n"
+	     << "                   formula and those still alive at its end\n"
+	     << "  --trace=PATH     write a timeline of the passes and rule\n"
+	     << "                   applications in Chrome's trace-event format\n"
+	     << "  --trace-depth=N  maximum nesting depth of the traced spans\n"
+	     << "  --trace-sample=R fraction of rule applications to be traced\n"
+	     << "  --cache=PATH     reuse and store normal forms in a persistent\n"
+	     << "                   cache file (shared with other processes)\n"
+	     << "  --cache-size=MB  maximum size of the cache (64 MiB by default)\n"
+	     << "  --cache-stats    report the hits and misses of the caches in the\n"
+	     << "                   standard error at the end\n"
+	     << "  --rename-cache   reuse the normal forms of the components of the\n"
+	     << "                   formulae up to the renaming of their atomic\n"
+	     << "                   propositions (kept in memory)\n"
+	     << "  --session        read commands \"set <name> <formula>\", \"remove\n"
+	     << "                   <name>\" and \"clear\" editing a conjunction of\n"
+	     << "                   named formulae, each answered by its updated\n"
+	     << "                   normal form (only the new formulae are normalized)\n"
+	     << "  --server=PATH    serve requests \"<id> <formula>\" on a Unix socket\n"
+	     << "                   answered by \"<id> <normal form>\" as they finish\n"
+	     << "  --threads=N      number of threads of the server (all by default)\n"
+	     << "  --max-work=N     reject the requests to the server whose estimated\n"
+	     << "                   cost exceeds N nodes (no limit by default)\n"
+	     << "  --parallel=N     normalize the independent conjuncts and disjuncts\n"
+	     << "                   of large formulae with N threads (0 for all, or\n"
+	     << "                   those of the server)\n\n"
+	     << "Formats are spot (Spot's infix syntax), dag (table of shared\n"
+	     << "subformulae) and binary (batch of formulae in binary format, which\n"
+	     << "is mapped into memory when read from a file).\n";
+}
+
+bool
+parseOptions(int argc, char* argv[], Options& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
 
-	while (!line.empty()) {
-		spot::parsed_formula parsed_form = spot::parse_infix_psl(line);
+		if (strncmp(arg, "--input=", 8) == 0) {
+			if (!parseFormat(arg + 8, options.input))
+				return false;
+		} else if (strncmp(arg, "--output=", 9) == 0) {
+			if (!parseFormat(arg + 9, options.output))
+				return false;
+		} else if (strcmp(arg, "--sizes") == 0)
+			options.sizes = true;
+		else if (strcmp(arg, "--convert") == 0)
+			options.convert = true;
+		else if (strncmp(arg, "--engine=", 9) == 0) {
+			if (!parseEngine(arg + 9, options.engine))
+				return false;
+		}
+		else if (strncmp(arg, "--simplify=", 11) == 0) {
+			char* end;
+			options.simplify = strtoul(arg + 11, &end, 10);
 
-		if (!parsed_form.format_errors(cerr)) {
-			spot::formula form = spot::negative_normal_form(parsed_form.f);
+			if (*end != '\0' || options.simplify > maxSimplifyLevel)
+				return false;
+		}
+		else if (strcmp(arg, "--stats=json") == 0)
+			options.stats = StatsFormat::JSON;
+		else if (strcmp(arg, "--stats=csv") == 0)
+			options.stats = StatsFormat::CSV;
+		else if (strcmp(arg, "--check-memory") == 0)
+			options.checkMemory = true;
+		else if (strncmp(arg, "--trace=", 8) == 0)
+			options.tracePath = arg + 8;
+		else if (strncmp(arg, "--trace-depth=", 14) == 0) {
+			char* end;
+			options.traceDepth = strtoul(arg + 14, &end, 10);
 
-			Node* input = from_spot(form);
-			input->addUser();
+			if (*end != '\0')
+				return false;
+		} else if (strncmp(arg, "--trace-sample=", 15) == 0) {
+			char* end;
+			options.traceSample = strtod(arg + 15, &end);
+
+			if (*end != '\0' || options.traceSample <= 0 || options.traceSample > 1)
+				return false;
+		}
+		else if (strncmp(arg, "--cache=", 8) == 0)
+			options.cachePath = arg + 8;
+		else if (strncmp(arg, "--cache-size=", 13) == 0) {
+			char* end;
+			options.cacheSize = strtoul(arg + 13, &end, 10) << 20;
 
-			Node* output = normalize(input);
-			spot::formula result = to_spot(output);
+			if (*end != '\0' || options.cacheSize == 0)
+				return false;
+		} else if (strcmp(arg, "--cache-stats") == 0)
+			options.cacheStats = true;
+		else if (strcmp(arg, "--rename-cache") == 0)
+			options.renameCache = true;
+		else if (strcmp(arg, "--session") == 0)
+			options.session = true;
+		else if (strncmp(arg, "--server=", 9) == 0)
+			options.serverPath = arg + 9;
+		else if (strncmp(arg, "--threads=", 10) == 0) {
+			char* end;
+			options.threads = strtoul(arg + 10, &end, 10);
 
-			cout << result << endl;
+			if (*end != '\0')
+				return false;
+		} else if (strncmp(arg, "--max-work=", 11) == 0) {
+			char* end;
+			options.maxWork = strtod(arg + 11, &end);
 
-			output->release();
-			input->removeUser();
+			if (*end != '\0' || options.maxWork < 0)
+				return false;
+		} else if (strncmp(arg, "--parallel=", 11) == 0) {
+			char* end;
+			options.parallel = strtoul(arg + 11, &end, 10);
+
+			if (*end != '\0')
+				return false;
 		}
+		else
+			return false;
+	}
+
+	return true;
+}
+
+//
+//	Main loop reading formulae in the Spot format (or any other
+//	selected format) and printing their normal forms (line by line)
+//
+
+void
+processFormula(NodeRef input, const Options& options, PersistentCache* cache,
+               ThreadPool* pool, RenamingCache* renaming, BatchWriter& batch)
+{
+	if (!input) {
+		// Missing formulae are kept in binary batches to preserve positions
+		if (options.output == Format::BINARY)
+			batch.add(nullptr);
+		return;
+	}
+
+	// Sizes are calculated before normalization, since the
+	// input formula may be modified in place
+	FormulaStats* stats = FormulaStats::current;
+	size_t inTree = 0, inDag = 0;
+
+	if (options.sizes || stats) {
+		inTree = treeSize(input.get());
+		inDag = dagSize(input.get());
+	}
+
+	// The effect of the simplification is reported as the triggers of the
+	// rules that it removes
+	double inTriggers = 0;
+	size_t simplifiedTree = 0, simplifiedDag = 0;
+
+	if (options.simplify > 0) {
+		if (options.sizes)
+			inTriggers = estimateCost(input.get()).triggers();
+
+		input = NodeRef(simplifyFormula(input.get(), options.simplify));
+
+		if (options.sizes) {
+			simplifiedTree = treeSize(input.get());
+			simplifiedDag = dagSize(input.get());
+		}
+	}
+
+	NodeRef output(options.convert ? input.get() : normalizeCached(input.get(), cache, pool, renaming));
+	string result;
+
+	if (options.output == Format::BINARY)
+		batch.add(output.get());
+	else {
+		result = writeFormula(output.get(), options.output);
+		cout << result << endl;
+	}
+
+	if (options.sizes) {
+		cerr << "Sizes: input tree " << inTree << " dag " << inDag;
+
+		if (options.simplify > 0)
+			cerr << ", simplified tree " << simplifiedTree << " dag " << simplifiedDag
+			     << " (triggers " << inTriggers << " -> "
+			     << estimateCost(input.get()).triggers() << ")";
+
+		cerr << ", output tree " << treeSize(output.get()) << " dag "
+		     << dagSize(output.get());
+
+		if (options.output != Format::BINARY)
+			cerr << ", text " << result.size();
+
+		cerr << "\n";
+	}
+
+	if (stats) {
+		stats->inTree = inTree;
+		stats->inDag = inDag;
+		stats->outTree = treeSize(output.get());
+		stats->outDag = dagSize(output.get());
+	}
+}
+
+/**
+ * Process a formula collecting its statistics if requested.
+ *
+ * @param text Text of the formula for the statistics.
+ * @param read Function that reads the formula.
+ * @return Whether no node has leaked (if checked).
+ */
+template<typename Reader>
+bool
+processWithStats(const string& text, Reader read, const Options& options,
+                 PersistentCache* cache, ThreadPool* pool, RenamingCache* renaming,
+                 BatchWriter& batch)
+{
+	TraceSpan span("formula");
+	span.annotate("formula", text);
+
+	if (options.stats == StatsFormat::NONE && !options.checkMemory) {
+		processFormula(NodeRef(read()), options, cache, pool, renaming, batch);
+		return true;
+	}
+
+	FormulaStats stats;
+	unordered_set<const Node*> alive;
+
+	if (options.checkMemory)
+		stats.alive = &alive;
+
+	{
+		StatsScope scope(&stats);
+		processFormula(NodeRef(read()), options, cache, pool, renaming, batch);
+	}
+
+	if (options.stats != StatsFormat::NONE)
+		printStats(cerr, options.stats, text, stats);
+
+	return !options.checkMemory || reportMemory(cerr, text, stats);
+}
+
+/**
+ * Normalize a formula with the Spot engine and print its normal form,
+ * reporting its sizes and statistics if requested.
+ */
+void
+processWithSpot(const string& text, const Options& options)
+{
+	TraceSpan span("formula");
+	span.annotate("formula", text);
+
+	FormulaStats stats;
+	string result;
+	{
+		const bool measured = options.sizes || options.stats != StatsFormat::NONE;
+		StatsScope scope(measured ? &stats : nullptr);
+		result = normalizeWithSpot(text);
+	}
+
+	if (result.empty())
+		return;
+
+	cout << result << endl;
+
+	if (options.sizes)
+		cerr << "Sizes: input tree " << stats.inTree << " dag " << stats.inDag
+		     << ", output tree " << stats.outTree << " dag " << stats.outDag << ", text "
+		     << result.size() << "\n";
 
+	if (options.stats != StatsFormat::NONE)
+		printStats(cerr, options.stats, text, stats);
+}
+
+bool
+normalizeLoop(const Options& options, PersistentCache* cache, ThreadPool* pool,
+              RenamingCache* renaming)
+{
+	// Results are written at the end in binary format
+	BatchWriter batch;
+	bool noLeaks = true;
+
+	if (options.stats == StatsFormat::CSV)
+		printStatsHeader(cerr);
+
+	if (options.input == Format::BINARY) {
+		BatchReader reader;
+
+		if (!reader.open(STDIN_FILENO))
+			return false;
+
+		for (size_t i = 0; i < reader.size(); ++i) {
+			Node* input = reader.get(i);
+
+			// The formula is identified by its Spot syntax in the statistics
+			// (its nodes are not checked for leaks, since they have been
+			// allocated before)
+			string text;
+
+			if ((options.stats != StatsFormat::NONE || options.checkMemory || options.tracePath) &&
+			    input)
+				text = writeFormula(input, Format::SPOT);
+
+			noLeaks &= processWithStats(
+			  text, [input] { return input; }, options, cache, pool, renaming, batch);
+		}
+	} else {
+		string line;
 		getline(cin, line);
+
+		while (!line.empty()) {
+			if (options.engine == Engine::SPOT)
+				processWithSpot(line, options);
+			else
+				noLeaks &= processWithStats(
+				  line, [&] { return readFormula(line, options.input); }, options, cache, pool,
+				  renaming, batch);
+			getline(cin, line);
+		}
+	}
+
+	return (options.output != Format::BINARY || batch.write(cout)) && noLeaks;
+}
+
+//
+//	Session mode, where a conjunction of named formulae is edited
+//	and renormalized incrementally
+//
+
+/**
+ * Answer a session command.
+ *
+ * @return The normal form of the specification after the command or an
+ * error message starting with an exclamation mark.
+ */
+string
+sessionCommand(Session& session, const string& line, Format input, Format output)
+{
+	istringstream words(line);
+	string command, name;
+	words >> command >> name;
+
+	if (command == "set" && !name.empty()) {
+		string formula;
+		getline(words >> ws, formula);
+
+		ostringstream errors;
+		Node* node = readFormula(formula, input, errors);
+
+		if (!node) {
+			string message = errors.str();
+
+			while (!message.empty() && message.back() == '\n')
+				message.pop_back();
+
+			for (char& c : message)
+				if (c == '\n')
+					c = ' ';
+
+			return "!" + message;
+		}
+
+		session.set(name, node);
+	} else if (command == "remove" && !name.empty()) {
+		if (!session.remove(name))
+			return "!no conjunct named " + name;
+	} else if (command == "clear")
+		session.clear();
+	else
+		return "!unknown command";
+
+	return writeFormula(session.normalForm(), output);
+}
+
+bool
+sessionLoop(const Options& options, PersistentCache* cache, ThreadPool* pool,
+            RenamingCache* renaming)
+{
+	if (options.input == Format::BINARY || options.output == Format::BINARY) {
+		cerr << "Error: the binary format cannot be used in session mode.\n";
+		return false;
+	}
+
+	Session session([&options, cache, pool, renaming](Node* formula) {
+		NodeRef normal;
+		{
+			NodeRef simplified(simplifyFormula(formula, options.simplify));
+			normal = NodeRef(normalizeCached(simplified.get(), cache, pool, renaming));
+		}
+		return normal.detach();
+	});
+
+	string line;
+
+	while (getline(cin, line))
+		if (!line.empty())
+			cout << sessionCommand(session, line, options.input, options.output) << endl;
+
+	return true;
+}
+
+bool
+run(const Options& options)
+{
+	// The Spot engine reads and writes Spot formulae without nodes
+	if (options.engine == Engine::SPOT &&
+	    (options.input != Format::SPOT || options.output != Format::SPOT || options.convert ||
+	     options.simplify > 0 || options.checkMemory || options.cachePath ||
+	     options.renameCache || options.session || options.serverPath || options.parallel != 1)) {
+		cerr << "Error: the spot engine only normalizes formulae in Spot's syntax one by one.\n";
+		return false;
+	}
+
+	unique_ptr<PersistentCache> cache;
+
+	if (options.cachePath) {
+		cache = make_unique<PersistentCache>(options.cachePath, options.cacheSize);
+
+		if (!cache->open())
+			return false;
+	}
+
+	unique_ptr<RenamingCache> renaming;
+
+	// The templates kept in the cache would be reported as leaked
+	if (options.renameCache && options.checkMemory)
+		cerr << "Warning: the renaming cache is not used when checking memory.\n";
+	else if (options.renameCache)
+		renaming = make_unique<RenamingCache>();
+
+	unique_ptr<ThreadPool> pool;
+
+	if (options.parallel != 1 && !options.serverPath)
+		pool = make_unique<ThreadPool>(options.parallel);
+
+	bool ok;
+
+	if (options.serverPath) {
+		ServerOptions serverOptions;
+		serverOptions.input = options.input;
+		serverOptions.output = options.output;
+		serverOptions.cache = cache.get();
+		serverOptions.renaming = renaming.get();
+		serverOptions.threads = options.threads;
+		serverOptions.split = options.parallel != 1;
+		serverOptions.maxWork = options.maxWork;
+		serverOptions.simplify = options.simplify;
+
+		ok = runServer(options.serverPath, serverOptions);
+	} else if (options.session)
+		ok = sessionLoop(options, cache.get(), pool.get(), renaming.get());
+	else if (options.tracePath) {
+		ofstream traceFile(options.tracePath);
+
+		if (!traceFile) {
+			cerr << "Error: cannot open the trace file " << options.tracePath << ".\n";
+			return false;
+		}
+
+		Tracer tracer(traceFile, options.traceDepth, options.traceSample);
+		ok = normalizeLoop(options, cache.get(), pool.get(), renaming.get());
+	} else
+		ok = normalizeLoop(options, cache.get(), pool.get(), renaming.get());
+
+	if (cache && options.cacheStats) {
+		const PersistentCache::Stats stats = cache->stats();
+		cerr << "Cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+		     << stats.stored << " stored, " << stats.evicted << " evicted\n";
+	}
+
+	if (renaming && options.cacheStats) {
+		const RenamingCache::Stats stats = renaming->stats();
+		cerr << "Renaming cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+		     << stats.templates << " templates\n";
 	}
+
+	return ok;
 }
 
 int
-main()
+main(int argc, char* argv[])
 {
-	normalizeLoop();
+	Options options;
+
+	if (!parseOptions(argc, argv, options)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	const bool ok = run(options);
 	Node::releaseStaticNodes();
 
-	return 0;
+	return ok ? 0 : 1;
 }
@@ -5,8 +5,18 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "normalizer.hh"
+#include "stats.hh"
+#include "threadpool.hh"
+#include "trace.hh"
 
 using namespace std;
 using Op = Node::Op;
@@ -51,14 +61,16 @@ replaceU(Node* node, Node* gfa)
 		case Op::W:
 		case Op::R: {
 			bool changed = false;
-			// These copies may be unnecessary in many cases, we could do them lazily
-			vector<Node*> ff_copy = node->children;
-			vector<Node*> weak_copy = node->children;
+			// The copies are only made when the first child changes
+			NodeList ff_copy, weak_copy;
 
 			for (size_t i = 0; i < node->children.size(); ++i) {
 				auto [ff, weak] = replaceU(node->children[i], gfa);
 
 				if (ff != nullptr) {
+					if (!changed)
+						ff_copy = weak_copy = node->children;
+
 					changed = true;
 					ff_copy[i] = ff;
 					weak_copy[i] = weak;
@@ -100,8 +112,8 @@ findU(Node* node, FindUResult& result)
 			for (size_t i = 0; i < node->children.size(); ++i)
 				if (findU(node->children[i], result)) {
 					// Rebuild 'node' with the two variants of U/M operator in the rule
-					vector<Node*> ff_copy = node->children;
-					vector<Node*> weak_copy = node->children;
+					NodeList ff_copy = node->children;
+					NodeList weak_copy = node->children;
 					ff_copy[i] = result.ff;
 					weak_copy[i] = result.weak;
 
@@ -140,6 +152,10 @@ findU(Node* node, FindUResult& result)
 Node*
 removeWU(Node* node)
 {
+	// Normal formulae do not contain U/M below W/R (except inside GF/FG)
+	if (node->isNormal())
+		return node;
+
 	switch (node->type) {
 		case Op::AND:
 		case Op::OR:
@@ -147,12 +163,15 @@ removeWU(Node* node)
 		case Op::U:
 		case Op::M: {
 			bool changed = false;
-			vector<Node*> copy = node->children;
+			NodeList copy; // Only made when the first child changes
 
 			for (size_t i = 0; i < node->children.size(); ++i) {
 				Node* newNode = removeWU(node->children[i]);
 
 				if (newNode != node->children[i]) {
+					if (!changed)
+						copy = node->children;
+
 					changed = true;
 					copy[i] = newNode;
 				}
@@ -170,8 +189,14 @@ removeWU(Node* node)
 
 			// (1) a W f[b U/M c] = a U f[b U/M c] | G a
 			if (containsU(node->children[1])) {
-				Node* uNode =
-				  Node::U(removeWU(node->children[0]), removeWU(node->children[1]));
+				countRule(1);
+				TraceSpan span("rule 1", node);
+				RuleProbe probe(1, node);
+
+				// Each operand is owned by a reference while the other is built,
+				// and the references are handed to the new node
+				NodeRef left(removeWU(node->children[0])), right(removeWU(node->children[1]));
+				Node* uNode = Node::U(move(left), move(right));
 				Node* gNode = Node::G(node->children[0]);
 				Node* orNode = Node::Or({ uNode, removeWU(gNode) });
 
@@ -182,11 +207,17 @@ removeWU(Node* node)
 			else {
 				FindUResult found;
 				if (findU(node->children[0], found)) {
-					Node* wwNode = Node::W(found.weak, node->children[1]);
+					countRule(2);
+					TraceSpan span("rule 2", node);
+					RuleProbe probe(2, node);
+
+					NodeRef weak(found.weak), ff(found.ff);
+					Node* wwNode = Node::W(move(weak), NodeRef(node->children[1]));
 					Node* andNode = Node::And({ Node::GF(found.gfa), removeWU(wwNode) });
-					Node* gffNode = Node::G(found.ff);
-					Node* urNode = Node::Or({ node->children[1], removeWU(gffNode) });
-					Node* uNode = Node::U(removeWU(node->children[0]), urNode);
+					Node* gffNode = Node::G(move(ff));
+					NodeRef left(removeWU(node->children[0]));
+					NodeRef right(Node::Or({ node->children[1], removeWU(gffNode) }));
+					Node* uNode = Node::U(move(left), move(right));
 					Node* orNode = Node::Or({ andNode, uNode });
 
 					return takePlace(orNode, node);
@@ -203,8 +234,12 @@ removeWU(Node* node)
 
 			// (1) f[a U/M b] R c = f[a U/M b] M c | G c
 			if (containsU(node->children[0])) {
-				Node* mNode =
-				  Node::M(removeWU(node->children[0]), removeWU(node->children[1]));
+				countRule(1);
+				TraceSpan span("rule 1", node);
+				RuleProbe probe(1, node);
+
+				NodeRef left(removeWU(node->children[0])), right(removeWU(node->children[1]));
+				Node* mNode = Node::M(move(left), move(right));
 				Node* gNode = Node::G(node->children[1]);
 				Node* orNode = Node::Or({ mNode, removeWU(gNode) });
 
@@ -215,11 +250,17 @@ removeWU(Node* node)
 			else {
 				FindUResult found;
 				if (findU(node->children[1], found)) {
-					Node* rrNode = Node::R(node->children[0], found.weak);
+					countRule(2);
+					TraceSpan span("rule 2", node);
+					RuleProbe probe(2, node);
+
+					NodeRef weak(found.weak), ff(found.ff);
+					Node* rrNode = Node::R(NodeRef(node->children[0]), move(weak));
 					Node* andNode = Node::And({ Node::GF(found.gfa), removeWU(rrNode) });
-					Node* gffNode = Node::G(found.ff);
-					Node* mlNode = Node::Or({ node->children[0], removeWU(gffNode) });
-					Node* mNode = Node::M(mlNode, removeWU(node->children[1]));
+					Node* gffNode = Node::G(move(ff));
+					NodeRef left(Node::Or({ node->children[0], removeWU(gffNode) }));
+					NodeRef right(removeWU(node->children[1]));
+					Node* mNode = Node::M(move(left), move(right));
 					Node* orNode = Node::Or({ andNode, mNode });
 
 					return takePlace(orNode, node);
@@ -279,12 +320,15 @@ replace(Node* node, Node* left, Node* right)
 		case Op::R:
 		case Op::M: {
 			bool changed = false;
-			vector<Node*> copy = node->children;
+			NodeList copy; // Only made when the first child changes
 
 			for (size_t i = 0; i < node->children.size(); ++i) {
 				Node* newNode = replace(node->children[i], left, right);
 
 				if (newNode != node->children[i]) {
+					if (!changed)
+						copy = node->children;
+
 					changed = true;
 					copy[i] = newNode;
 				}
@@ -309,14 +353,66 @@ replace(Node* node, Node* left, Node* right)
 	}
 }
 
+/**
+ * Decision diagram of the case splits of rules (3) and (4), whose inner
+ * nodes are the GF-formulae split on and whose edges lead to the cofactors
+ * where they are replaced by true and false. Cofactors are identified by
+ * their structure, so that those reached by different cases are normalized
+ * once and their results shared, and splits whose cofactors have the same
+ * result are removed, since (GF a & f) | f = f.
+ */
+struct CaseSplits
+{
+	// Cofactors and their results by structural hash (the cofactors may be
+	// rewritten in place by the normalization, but always into equivalent
+	// formulae, so their results are still valid)
+	unordered_multimap<uint64_t, pair<Node*, Node*>> cofactors;
+	vector<Node*> table; // Cofactors and results kept alive until the end
+};
+
+Node* removeGF(Node* node, CaseSplits& splits);
+
+/**
+ * Normalize a cofactor of a case split, or reuse the result of an equal one.
+ */
 Node*
-removeGF(Node* node)
+removeGFCofactor(Node* cofactor, CaseSplits& splits)
 {
+	if (cofactor->isNormal())
+		return cofactor;
+
+	const uint64_t hash = structuralHash(cofactor);
+	auto [begin, end] = splits.cofactors.equal_range(hash);
+
+	for (auto it = begin; it != end; ++it)
+		if (*it->second.first == *cofactor) {
+			cofactor->release();
+			return it->second.second;
+		}
+
+	cofactor->addUser();
+	Node* result = removeGF(cofactor, splits);
+	result->addUser();
+
+	splits.table.push_back(cofactor);
+	splits.table.push_back(result);
+	splits.cofactors.emplace(hash, make_pair(cofactor, result));
+
+	return result;
+}
+
+Node*
+removeGF(Node* node, CaseSplits& splits)
+{
+	// Normal formulae do not contain GF/FG below temporal operators
+	if (node->isNormal())
+		return node;
+
 	// Removing GF separately on each topmost temporal formula reduces
 	// in some cases (and increase in some others) the output size
 	if (is(node, Op::AND) || is(node, Op::OR)) {
 		for (Node*& child : node->children) {
-			Node* newChild = removeGF(child);
+			Node* newChild = removeGF(child, splits);
 
 			if (newChild != child) {
 				newChild->addUser();
@@ -325,32 +421,50 @@ removeGF(Node* node)
 			}
 		}
 
+		// The children may have become normal
+		node->classify();
 		return node;
 	}
 
 	Node* found = findGF(node);
 
 	// (3) f[GF a] = (GF a & f[tt]) | f[ff]
-	// (4) f[FG a] = (FG a & f[tt]) | f[ff]
+	// (3) f[FG a] = (FG a & f[tt]) | f[ff]
 	if (found) {
-		Node* ttVariant = replace(node, found, Node::tt());
-		Node* ffVariant = replace(node, found, Node::ff());
-		Node* andNode = Node::And({ found, removeGF(ttVariant) });
-		Node* orNode = Node::Or({ andNode, removeGF(ffVariant) });
-
-		// orNode could be a subformula of 'node', so we have to protect it from
-		// deletion (addUser/removeUser are not used because orNode does not have
-		// any user yet and removeUser would delete it)
-		orNode->refCount++;
+		countRule(3);
+		TraceSpan span("rule 3", node);
+		RuleProbe probe(3, node);
+
+		Node* ttVariant = removeGFCofactor(replace(node, found, Node::tt()), splits);
+		Node* ffVariant = removeGFCofactor(replace(node, found, Node::ff()), splits);
+
+		// The result could be a subformula of 'node', so we have to protect it
+		// from deletion while 'node' is released
+		NodeRef result;
+
+		if (*ttVariant == *ffVariant) {
+			result = NodeRef(ttVariant);
+
+			if (ffVariant != ttVariant)
+				ffVariant->release();
+		} else
+			result = NodeRef(Node::Or({ Node::And({ found, ttVariant }), ffVariant }));
+
 		node->release();
-		orNode->refCount--;
 
-		return orNode;
+		return result.detach();
 	}
 
 	return node;
 }
 
+Node*
+removeGF(Node* tree)
+{
+	CaseSplits splits;
+	return releaseTable(splits.table, removeGF(tree, splits));
+}
+
 //
 //	Step 3: remove W/R inside GF
 //
@@ -373,14 +487,16 @@ replaceW(Node* node, Node* fga)
 		case Op::U:
 		case Op::M: {
 			bool changed = false;
-			// These copies may be unnecessary in many cases, we could do them lazily
-			vector<Node*> tt_copy = node->children;
-			vector<Node*> strong_copy = node->children;
+			// The copies are only made when the first child changes
+			NodeList tt_copy, strong_copy;
 
 			for (size_t i = 0; i < node->children.size(); ++i) {
 				auto [tt, strong] = replaceW(node->children[i], fga);
 
 				if (tt != nullptr) {
+					if (!changed)
+						tt_copy = strong_copy = node->children;
+
 					changed = true;
 					tt_copy[i] = tt;
 					strong_copy[i] = strong;
@@ -422,8 +538,8 @@ findW(Node* node, FindWResult& result)
 			for (size_t i = 0; i < node->children.size(); ++i)
 				if (findW(node->children[i], result)) {
 					// Rebuild 'node' with the three variants of U/M operator in the rule
-					vector<Node*> strong_copy = node->children;
-					vector<Node*> tt_copy = node->children;
+					NodeList strong_copy = node->children;
+					NodeList tt_copy = node->children;
 
 					strong_copy[i] = result.strong;
 					tt_copy[i] = result.tt;
@@ -483,6 +599,10 @@ fixGFW(Node* node, Node* existing)
 	// (4) GF f[a W b] = GF f[a U b] | (FG a & GF f[tt])
 	// (4) GF f[a R b] = GF f[a M b] | (FG b & GF f[tt])
 	if (findW(node, found)) {
+		countRule(4);
+		TraceSpan span("rule 4", node);
+		RuleProbe probe(4, node);
+
 		Node* andNode = Node::And({ fixFGU(found.fga), fixGFW(found.tt) });
 		Node* orNode = Node::Or({ fixGFW(found.strong), andNode });
 
@@ -502,6 +622,10 @@ fixFGU(Node* node, Node* existing)
 	// (5) FG f[a U b] = (GF b & FG f[a W b]) | FG f[ff]
 	// (5) FG f[a M b] = (GF a & FG f[a R b]) | FG f[ff]
 	if (findU(node, found)) {
+		countRule(5);
+		TraceSpan span("rule 5", node);
+		RuleProbe probe(5, node);
+
 		Node* andNode = Node::And({ fixGFW(found.gfa), fixFGU(found.weak) });
 		Node* orNode = Node::Or({ andNode, fixFGU(found.ff) });
 
@@ -514,16 +638,23 @@ fixFGU(Node* node, Node* existing)
 Node*
 fixGF(Node* node)
 {
+	// Normal formulae do not contain W/R inside GF nor U/M inside FG
+	if (node->isNormal())
+		return node;
+
 	switch (node->type) {
 		case Op::AND:
 		case Op::OR: {
 			bool changed = false;
-			vector<Node*> copy = node->children;
+			NodeList copy; // Only made when the first child changes
 
 			for (size_t i = 0; i < node->children.size(); ++i) {
 				Node* newNode = fixGF(node->children[i]);
 
 				if (newNode != node->children[i]) {
+					if (!changed)
+						copy = node->children;
+
 					changed = true;
 					copy[i] = newNode;
 				}
@@ -547,7 +678,267 @@ fixGF(Node* node)
 //
 
 Node*
-normalize(Node* tree)
+normalizeSequential(Node* tree)
+{
+	// Formulae already in normal form are left untouched by every step
+	if (tree->isNormal())
+		return tree;
+
+	{
+		PhaseTimer timer(FormulaStats::REMOVE_WU);
+		TraceSpan span("removeWU");
+		tree = removeWU(tree);
+	}
+	{
+		PhaseTimer timer(FormulaStats::REMOVE_GF);
+		TraceSpan span("removeGF");
+		tree = removeGF(tree);
+	}
+
+	PhaseTimer timer(FormulaStats::FIX_GF);
+	TraceSpan span("fixGF");
+	return fixGF(tree);
+}
+
+//
+//	Parallel normalization of the top-level components
+//
+
+// Minimum number of nodes of a formula to be split into components
+constexpr size_t minParallelSize = 64;
+
+/**
+ * Components of the top-level Boolean structure of a formula (its maximal
+ * subformulae that are not conjunctions or disjunctions) and their normal
+ * forms. The state is shared with the helper threads, which may start after
+ * all components have been normalized.
+ */
+struct Components
+{
+	vector<Node*> nodes;
+	vector<Node*> results;
+	unordered_set<const Node*> boolean; // Nodes of the top-level structure
+	// Components sharing some nodes, which must be normalized by the same thread
+	// since the normalization may modify shared nodes in place (largest first)
+	vector<vector<size_t>> groups;
+
+	atomic<size_t> next{ 0 };
+	size_t finished = 0;
+	std::mutex mutex;
+	condition_variable done;
+
+	/**
+	 * Normalize groups of components until none is left.
+	 */
+	void work();
+};
+
+void
+Components::work()
+{
+	for (size_t i = next++; i < groups.size(); i = next++) {
+		for (size_t component : groups[i])
+			results[component] = normalizeSequential(nodes[component]);
+
+		lock_guard<std::mutex> lock(mutex);
+
+		if (++finished == groups.size())
+			done.notify_all();
+	}
+}
+
+void
+collectComponents(Node* node, unordered_map<Node*, size_t>& index, Components& components)
+{
+	if (is(node, Op::AND) || is(node, Op::OR)) {
+		if (!components.boolean.insert(node).second)
+			return;
+
+		for (Node* child : node->children)
+			collectComponents(child, index, components);
+	} else if (index.emplace(node, components.nodes.size()).second)
+		components.nodes.push_back(node);
+}
+
+/**
+ * Group the components that share some (non-unique) node.
+ *
+ * @return The number of nodes of the components, or zero if some component
+ * contains a node of the top-level structure (which its normalization could
+ * rewrite in place while the structure is reassembled).
+ */
+size_t
+groupComponents(Components& components)
+{
+	const size_t count = components.nodes.size();
+	vector<size_t> parent(count), sizes(count, 0);
+	iota(parent.begin(), parent.end(), 0);
+
+	auto find = [&parent](size_t component) {
+		while (parent[component] != component)
+			component = parent[component] = parent[parent[component]];
+		return component;
+	};
+
+	unordered_map<const Node*, size_t> owner;
+	vector<Node*> pending;
+
+	for (size_t i = 0; i < count; ++i) {
+		pending.push_back(components.nodes[i]);
+
+		while (!pending.empty()) {
+			Node* node = pending.back();
+			pending.pop_back();
+
+			if (node->isUnique())
+				continue;
+
+			if (components.boolean.count(node))
+				return 0;
+
+			auto [it, inserted] = owner.emplace(node, i);
+
+			if (!inserted) {
+				parent[find(it->second)] = find(i);
+				continue;
+			}
+
+			sizes[i]++;
+			pending.insert(pending.end(), node->children.begin(), node->children.end());
+		}
+	}
+
+	// Collect the groups with their sizes
+	unordered_map<size_t, size_t> groupOf;
+	vector<size_t> groupSizes;
+
+	for (size_t i = 0; i < count; ++i) {
+		auto [it, inserted] = groupOf.emplace(find(i), components.groups.size());
+
+		if (inserted) {
+			components.groups.emplace_back();
+			groupSizes.push_back(0);
+		}
+
+		components.groups[it->second].push_back(i);
+		groupSizes[it->second] += sizes[i];
+	}
+
+	vector<size_t> order(components.groups.size());
+	iota(order.begin(), order.end(), 0);
+	sort(order.begin(), order.end(),
+	     [&groupSizes](size_t a, size_t b) { return groupSizes[a] > groupSizes[b]; });
+
+	vector<vector<size_t>> sorted;
+
+	for (size_t i : order)
+		sorted.push_back(move(components.groups[i]));
+
+	components.groups = move(sorted);
+
+	return accumulate(sizes.begin(), sizes.end(), size_t(0));
+}
+
+/**
+ * Rebuild the top-level Boolean structure of a formula with the normal forms
+ * of its components (the rebuilt nodes are kept alive by the table).
+ */
+Node*
+reassemble(Node* node, const unordered_map<Node*, size_t>& index,
+           const Components& components, unordered_map<Node*, Node*>& rebuilt,
+           vector<Node*>& table)
 {
-	return fixGF(removeGF(removeWU(tree)));
+	if (!is(node, Op::AND) && !is(node, Op::OR))
+		return components.results[index.at(node)];
+
+	auto it = rebuilt.find(node);
+
+	if (it != rebuilt.end())
+		return it->second;
+
+	bool changed = false;
+	NodeList args(node->children.size());
+
+	for (size_t i = 0; i < args.size(); ++i) {
+		args[i] = reassemble(node->children[i], index, components, rebuilt, table);
+		changed |= args[i] != node->children[i];
+	}
+
+	Node* result = changed ? Node::make(node->type, move(args)) : node;
+	result->addUser();
+	table.push_back(result);
+
+	return rebuilt[node] = result;
+}
+
+/**
+ * Normalize the components of a formula concurrently.
+ *
+ * @return The normal form or null if the formula is not worth splitting.
+ */
+Node*
+normalizeParallel(Node* tree, ThreadPool& pool)
+{
+	auto components = make_shared<Components>();
+	unordered_map<Node*, size_t> index;
+
+	collectComponents(tree, index, *components);
+
+	if (groupComponents(*components) < minParallelSize || components->groups.size() < 2)
+		return nullptr;
+
+	TraceSpan span("components", tree);
+	span.annotate("groups", to_string(components->groups.size()));
+
+	components->results.resize(components->nodes.size());
+
+	const size_t helpers = min(pool.size(), components->groups.size() - 1);
+
+	for (size_t i = 0; i < helpers; ++i)
+		pool.submit([components] { components->work(); });
+
+	components->work();
+
+	{
+		unique_lock<std::mutex> lock(components->mutex);
+		components->done.wait(
+		  lock, [&components] { return components->finished == components->groups.size(); });
+	}
+
+	// The normal forms of the components are kept alive by the table, since
+	// the simplifying constructors may try to release them
+	vector<Node*> table;
+
+	for (Node* result : components->results) {
+		result->addUser();
+		table.push_back(result);
+	}
+
+	unordered_map<Node*, Node*> rebuilt;
+	Node* result =
+	  releaseTable(table, reassemble(tree, index, *components, rebuilt, table));
+
+	return result != tree ? takePlace(result, tree) : tree;
+}
+
+Node*
+normalize(Node* tree, ThreadPool* pool)
+{
+	if (LTLNORM_PROBE_ENABLED(formula__start))
+		LTLNORM_PROBE(formula__start, tree, treeSize(tree), dagSize(tree));
+
+	const ProbeTimer timer(LTLNORM_PROBE_ENABLED(formula__end));
+	Node* result = nullptr;
+
+	if (pool && !FormulaStats::current && !tree->isNormal() &&
+	    (is(tree, Op::AND) || is(tree, Op::OR)))
+		result = normalizeParallel(tree, *pool);
+
+	if (!result)
+		result = normalizeSequential(tree);
+
+	if (LTLNORM_PROBE_ENABLED(formula__end))
+		LTLNORM_PROBE(formula__end, result, treeSize(result), timer.elapsed());
+
+	return result;
 }
@@ -9,9 +9,22 @@
 #ifndef NORMALIZER_HH
 #define NORMALIZER_HH
 
+/**
+ * Version of the normalizer, to be increased whenever the normal forms it
+ * produces change (results stored by previous versions are then ignored).
+ */
+constexpr unsigned normalizerVersion = 3;
+
+class ThreadPool;
+
 /**
  * Normalize the given formula.
+ *
+ * If a pool of threads is given, the independent components of the top-level
+ * conjunctions and disjunctions of large formulae are normalized concurrently
+ * by its threads and the calling one. Statistics are only collected by the
+ * calling thread, so formulae are normalized sequentially while collecting them.
  */
-Node* normalize(Node* tree);
+Node* normalize(Node* tree, ThreadPool* pool = nullptr);
 
 #endif // NORMALIZER_HH
@@ -0,0 +1,177 @@
+/**
+ * @file pipeline.cc
+ *
+ * Read, normalize and write formulae in the supported formats.
+ */
+
+#include <cstring>
+#include <mutex>
+#include <sstream>
+
+#include <spot/tl/nenoform.hh>
+#include <spot/tl/parse.hh>
+#include <spot/tl/simplify.hh>
+
+#include "dagio.hh"
+#include "normalizer.hh"
+#include "pipeline.hh"
+#include "simplify.hh"
+#include "spotnorm.hh"
+#include "stats.hh"
+#include "tfspot.hh"
+
+using namespace std;
+
+// Spot formulae are hash-consed in global tables without synchronization,
+// so they must only be created and destroyed with this lock held
+mutex spotMutex;
+
+bool
+parseFormat(const char* text, Format& format)
+{
+	if (strcmp(text, "spot") == 0)
+		format = Format::SPOT;
+	else if (strcmp(text, "dag") == 0)
+		format = Format::DAG;
+	else if (strcmp(text, "binary") == 0)
+		format = Format::BINARY;
+	else
+		return false;
+
+	return true;
+}
+
+bool
+parseEngine(const char* text, Engine& engine)
+{
+	if (strcmp(text, "node") == 0)
+		engine = Engine::NODE;
+	else if (strcmp(text, "spot") == 0)
+		engine = Engine::SPOT;
+	else
+		return false;
+
+	return true;
+}
+
+Node*
+readFormula(const string& text, Format format, ostream& errors)
+{
+	if (format == Format::DAG)
+		return parseDag(text, errors);
+
+	lock_guard<mutex> lock(spotMutex);
+	spot::parsed_formula parsed_form = spot::parse_infix_psl(text);
+
+	if (parsed_form.format_errors(errors))
+		return nullptr;
+
+	return from_spot(spot::negative_normal_form(parsed_form.f));
+}
+
+string
+writeFormula(Node* formula, Format format)
+{
+	ostringstream out;
+
+	if (format == Format::DAG)
+		printDag(out, formula);
+	else {
+		lock_guard<mutex> lock(spotMutex);
+		out << to_spot(formula);
+	}
+
+	return out.str();
+}
+
+Node*
+readFormula(const spot::formula& formula)
+{
+	lock_guard<mutex> lock(spotMutex);
+	return from_spot(spot::negative_normal_form(formula));
+}
+
+spot::formula
+writeFormula(Node* formula)
+{
+	lock_guard<mutex> lock(spotMutex);
+	return to_spot(formula);
+}
+
+Node*
+simplifyFormula(Node* input, unsigned level)
+{
+	// Formulae in normal form are not rewritten by the normalization
+	if (level == 0 || input->isNormal())
+		return input;
+
+	NodeRef formula(input), simplified;
+
+	// The conversions are timed in their own phases
+	if (level > 1) {
+		lock_guard<mutex> lock(spotMutex);
+		spot::formula converted = to_spot(formula.get());
+		{
+			PhaseTimer timer(FormulaStats::SIMPLIFY);
+			spot::tl_simplifier simplifier(spot::tl_simplifier_options(level - 1));
+			converted = spot::negative_normal_form(simplifier.simplify(converted));
+		}
+		formula = NodeRef(from_spot(converted));
+	}
+
+	{
+		PhaseTimer timer(FormulaStats::SIMPLIFY);
+		simplified = NodeRef(simplify(formula.get()));
+	}
+
+	// The simplified formula may be the converted one
+	formula = NodeRef();
+	return simplified.detach();
+}
+
+Node*
+normalizeCached(Node* input, PersistentCache* cache, ThreadPool* pool, RenamingCache* renaming)
+{
+	if (renaming)
+		return renaming->normalize(
+		  input, [cache, pool](Node* shape) { return normalizeCached(shape, cache, pool); });
+
+	if (!cache)
+		return normalize(input, pool);
+
+	PersistentCache::Key key = PersistentCache::key(input);
+
+	if (Node* cached = cache->lookup(key))
+		return cached;
+
+	Node* output = normalize(input, pool);
+	cache->store(key, output);
+
+	return output;
+}
+
+string
+normalizeWithSpot(const string& text, ostream& errors)
+{
+	// The lock is held during the whole normalization, which creates and
+	// destroys Spot formulae
+	lock_guard<mutex> lock(spotMutex);
+	spot::parsed_formula parsed_form = spot::parse_infix_psl(text);
+
+	if (parsed_form.format_errors(errors))
+		return string();
+
+	const spot::formula input = spot::negative_normal_form(parsed_form.f);
+	const spot::formula output = normalizeSpot(input);
+
+	if (FormulaStats* stats = FormulaStats::current) {
+		stats->inTree = treeSize(input);
+		stats->inDag = dagSize(input);
+		stats->outTree = treeSize(output);
+		stats->outDag = dagSize(output);
+	}
+
+	ostringstream out;
+	out << output;
+	return out.str();
+}
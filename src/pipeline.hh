@@ -0,0 +1,107 @@
+/**
+ * @file pipeline.hh
+ *
+ * Read, normalize and write formulae in the supported formats.
+ *
+ * These functions can be called from different threads. Spot is not
+ * thread-safe, so its formulae are only handled with an internal lock held.
+ */
+
+#ifndef PIPELINE_HH
+#define PIPELINE_HH
+
+#include <iostream>
+#include <string>
+
+#include "cache.hh"
+#include "renaming.hh"
+#include "tree.hh"
+
+namespace spot {
+class formula;
+}
+
+class ThreadPool;
+
+enum class Format
+{
+	SPOT,  // Spot's infix syntax
+	DAG,   // Table of shared subformulae (see dagio.hh)
+	BINARY // Binary batch of formulae (see binio.hh)
+};
+
+enum class Engine
+{
+	NODE, // Rewriting of the DAG of nodes (see normalizer.hh)
+	SPOT  // Rewriting of Spot's formulae (see spotnorm.hh)
+};
+
+/**
+ * Parse the name of a format (spot, dag or binary).
+ */
+bool parseFormat(const char* text, Format& format);
+
+/**
+ * Parse the name of a normalization engine (node or spot).
+ */
+bool parseEngine(const char* text, Engine& engine);
+
+/**
+ * Read a formula in a textual format (in negation normal form).
+ *
+ * @return The formula or null if it is malformed, in which case the error
+ * is reported to the given stream.
+ */
+Node* readFormula(const std::string& text, Format format,
+                  std::ostream& errors = std::cerr);
+
+/**
+ * Write a formula in a textual format.
+ */
+std::string writeFormula(Node* formula, Format format);
+
+/**
+ * Convert a Spot formula (in negation normal form) and back.
+ *
+ * Only the internal lock is held, so Spot formulae must not be used by the
+ * caller at the same time in other threads.
+ */
+Node* readFormula(const spot::formula& formula);
+spot::formula writeFormula(Node* formula);
+
+/**
+ * Highest level of simplification (see simplifyFormula).
+ */
+constexpr unsigned maxSimplifyLevel = 4;
+
+/**
+ * Simplify a formula before its normalization at the given level: none (0),
+ * with the rewriting of simplify.hh (1), or first with Spot's simplifier at
+ * its levels 1 to 3 (2 to 4), which add the basic rewriting rules, checks of
+ * syntactic implication, and checks of language containment (much slower).
+ *
+ * @return The simplified formula (without users) or the same formula.
+ */
+Node* simplifyFormula(Node* input, unsigned level);
+
+/**
+ * Normalize a formula, looking for it first in the given cache (if any)
+ * and storing its normal form there otherwise. The components of large
+ * formulae are normalized concurrently in the given pool (if any). With
+ * a renaming cache, the components are instead normalized one by one
+ * through it, and then through the persistent cache.
+ */
+Node* normalizeCached(Node* input, PersistentCache* cache, ThreadPool* pool = nullptr,
+                      RenamingCache* renaming = nullptr);
+
+/**
+ * Normalize a formula in Spot's syntax with the Spot engine, without
+ * converting it into nodes. The sizes of the input and output formulae are
+ * recorded in the current statistics (if any).
+ *
+ * @return The normal form in Spot's syntax, or an empty string if the formula
+ * is malformed, in which case the error is reported to the given stream.
+ */
+std::string normalizeWithSpot(const std::string& text, std::ostream& errors = std::cerr);
+
+#endif // PIPELINE_HH
@@ -0,0 +1,19 @@
+/**
+ * @file probes.cc
+ *
+ * Semaphores of the USDT probes, which tools increment while they are
+ * attached to the probes (see probes.hh).
+ */
+
+#include "probes.hh"
+
+#ifdef LTLNORM_USDT
+
+#define LTLNORM_PROBE_SEMAPHORE_DEF(name)                                      \
+	volatile unsigned short ltlnorm_##name##_semaphore __attribute__((section(".probes"))) = 0;
+
+extern "C" {
+LTLNORM_FOR_EACH_PROBE(LTLNORM_PROBE_SEMAPHORE_DEF)
+}
+
+#endif // LTLNORM_USDT
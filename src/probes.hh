@@ -0,0 +1,109 @@
+/**
+ * @file probes.hh
+ *
+ * USDT probes (static tracepoints of Linux) at the hot points of the
+ * normalization, so that a running process can be profiled with perf or
+ * bpftrace without recompiling it.
+ *
+ * Probes are only compiled with the usdt option of Meson, which defines
+ * LTLNORM_USDT, and then cost a no-op instruction each while no tool is
+ * attached to them. The arguments that take time to compute, like sizes
+ * of formulae and durations, are only computed while the probe is attached,
+ * as signaled by its semaphore. The probes of the provider ltlnorm are:
+ *
+ *  - formula__start(node, tree size, DAG size) and formula__end(node,
+ *    tree size, nanoseconds) around each call to normalize,
+ *  - pass__entry(phase, name) and pass__return(phase, name, nanoseconds)
+ *    around each phase (see FormulaStats::Phase),
+ *  - rule__entry(rule, node, tree size) and rule__return(rule, nanoseconds)
+ *    around each application of a rule (numbered as in normalizer.cc),
+ *  - node__alloc(node, operator) and node__release(node, operator) for each
+ *    node except the unique ones.
+ *
+ * For example, the latency of each rule is shown as histograms by
+ *
+ *   bpftrace -p PID -e 'usdt:/path/to/libltlnorm.so:ltlnorm:rule__return
+ *                       { @ns[arg0] = hist(arg1); }'
+ */
+
+#ifndef PROBES_HH
+#define PROBES_HH
+
+#include <chrono>
+#include <cstdint>
+
+#ifdef LTLNORM_USDT
+
+// The probes have semaphores, which are defined in probes.cc
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define LTLNORM_FOR_EACH_PROBE(F)                                              \
+	F(formula__start)                                                             \
+	F(formula__end)                                                               \
+	F(pass__entry)                                                                \
+	F(pass__return)                                                               \
+	F(rule__entry)                                                                \
+	F(rule__return)                                                               \
+	F(node__alloc)                                                                \
+	F(node__release)
+
+#define LTLNORM_PROBE_SEMAPHORE(name)                                          \
+	extern volatile unsigned short ltlnorm_##name##_semaphore                     \
+	  __attribute__((section(".probes")));
+
+extern "C" {
+LTLNORM_FOR_EACH_PROBE(LTLNORM_PROBE_SEMAPHORE)
+}
+
+/**
+ * Whether some tool is attached to a probe.
+ */
+#define LTLNORM_PROBE_ENABLED(name) __builtin_expect(ltlnorm_##name##_semaphore != 0, 0)
+
+/**
+ * Fire a probe with the given arguments.
+ */
+#define LTLNORM_PROBE(name, ...) STAP_PROBEV(ltlnorm, name, __VA_ARGS__)
+
+#else
+
+#define LTLNORM_PROBE_ENABLED(name) false
+#define LTLNORM_PROBE(name, ...)                                               \
+	do {                                                                          \
+	} while (0)
+
+#endif // LTLNORM_USDT
+
+/**
+ * Time elapsed since the object was created, which is only measured if it
+ * is enabled (when some tool is attached to the probe that reports it).
+ */
+class ProbeTimer
+{
+	public:
+	explicit ProbeTimer(bool enabled)
+	  : enabled(enabled)
+	{
+		if (enabled)
+			start = std::chrono::steady_clock::now();
+	}
+
+	/**
+	 * Nanoseconds elapsed (or zero if disabled).
+	 */
+	uint64_t elapsed() const
+	{
+		if (!enabled)
+			return 0;
+
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	}
+
+	private:
+	bool enabled;
+	std::chrono::steady_clock::time_point start;
+};
+
+#endif // PROBES_HH
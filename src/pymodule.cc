@@ -0,0 +1,193 @@
+/**
+ * @file pymodule.cc
+ *
+ * Python extension module normalizing formulae in process.
+ *
+ * Formulae are exchanged as objects of Spot's Python bindings (or as text),
+ * which are generated by SWIG, so they are unwrapped and wrapped through the
+ * external SWIG runtime without printing or parsing them. Spot is not
+ * thread-safe and Python code may use it concurrently, so formulae are only
+ * converted with the GIL held, and the normalization runs without it.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <vector>
+
+#include <spot/tl/formula.hh>
+
+#include "swigpyrun.h"
+
+#include "pipeline.hh"
+#include "threadpool.hh"
+
+using namespace std;
+
+// SWIG type of spot::formula in Spot's bindings
+swig_type_info* formulaType = nullptr;
+
+/**
+ * Convert a Spot formula or its text into a node.
+ *
+ * @return The node or null with a Python exception set.
+ */
+Node*
+toNode(PyObject* object)
+{
+	if (PyUnicode_Check(object)) {
+		const char* text = PyUnicode_AsUTF8(object);
+
+		if (!text)
+			return nullptr;
+
+		ostringstream errors;
+		Node* node = readFormula(text, Format::SPOT, errors);
+
+		if (!node)
+			PyErr_SetString(PyExc_ValueError, errors.str().c_str());
+
+		return node;
+	}
+
+	void* pointer;
+
+	if (!SWIG_IsOK(SWIG_ConvertPtr(object, &pointer, formulaType, 0))) {
+		PyErr_SetString(PyExc_TypeError, "expected a spot.formula or a string");
+		return nullptr;
+	}
+
+	return readFormula(*static_cast<spot::formula*>(pointer));
+}
+
+/**
+ * Convert a node into a new Spot formula object.
+ */
+PyObject*
+toPython(Node* node)
+{
+	auto formula = new spot::formula(writeFormula(node));
+	return SWIG_NewPointerObj(formula, formulaType, SWIG_POINTER_OWN);
+}
+
+PyObject*
+pyNormalize(PyObject*, PyObject* arg)
+{
+	NodeRef input(toNode(arg));
+
+	if (!input)
+		return nullptr;
+
+	Node* normal;
+
+	Py_BEGIN_ALLOW_THREADS;
+	normal = normalizeCached(input.get(), nullptr);
+	Py_END_ALLOW_THREADS;
+
+	return toPython(NodeRef(normal).get());
+}
+
+PyObject*
+pyNormalizeMany(PyObject*, PyObject* args, PyObject* kwargs)
+{
+	static const char* keywords[] = { "formulae", "threads", nullptr };
+	PyObject* iterable;
+	unsigned threads = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|I", const_cast<char**>(keywords),
+	                                 &iterable, &threads))
+		return nullptr;
+
+	PyObject* sequence = PySequence_Fast(iterable, "expected a sequence of formulae");
+
+	if (!sequence)
+		return nullptr;
+
+	const size_t count = PySequence_Fast_GET_SIZE(sequence);
+	vector<NodeRef> nodes(count);
+
+	for (size_t i = 0; i < count; ++i) {
+		nodes[i] = NodeRef(toNode(PySequence_Fast_GET_ITEM(sequence, i)));
+
+		if (!nodes[i]) {
+			Py_DECREF(sequence);
+			return nullptr;
+		}
+	}
+
+	Py_DECREF(sequence);
+
+	// The formulae are distributed dynamically, since their costs differ
+	Py_BEGIN_ALLOW_THREADS;
+	{
+		ThreadPool pool(threads);
+		atomic<size_t> next{ 0 };
+
+		for (size_t k = 0; k < min(pool.size(), count); ++k)
+			pool.submit([&nodes, &next, count] {
+				for (size_t i; (i = next++) < count;)
+					nodes[i] = NodeRef(normalizeCached(nodes[i].get(), nullptr));
+			});
+
+		pool.wait();
+	}
+	Py_END_ALLOW_THREADS;
+
+	PyObject* results = PyList_New(count);
+
+	if (!results)
+		return nullptr;
+
+	for (size_t i = 0; i < count; ++i) {
+		PyObject* result = toPython(nodes[i].get());
+
+		if (!result) {
+			Py_DECREF(results);
+			return nullptr;
+		}
+
+		PyList_SET_ITEM(results, i, result);
+	}
+
+	return results;
+}
+
+PyMethodDef methods[] = {
+	{ "normalize", pyNormalize, METH_O,
+	  "normalize(formula) -> spot.formula\n\n"
+	  "Normalize a formula given as a spot.formula or as text." },
+	{ "normalize_many", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(pyNormalizeMany)),
+	  METH_VARARGS | METH_KEYWORDS,
+	  "normalize_many(formulae, threads=0) -> list\n\n"
+	  "Normalize a sequence of formulae in parallel with the given number of\n"
+	  "threads (all available by default), releasing the GIL." },
+	{ nullptr, nullptr, 0, nullptr }
+};
+
+PyModuleDef moduleDef = {
+	PyModuleDef_HEAD_INIT, "ltlnorm", "Normalization of LTL formulae into the Delta2 class",
+	-1, methods, nullptr, nullptr, nullptr, nullptr
+};
+
+PyMODINIT_FUNC
+PyInit_ltlnorm()
+{
+	// Spot's bindings register the type of formulae in the SWIG runtime
+	PyObject* spotModule = PyImport_ImportModule("spot");
+
+	if (!spotModule)
+		return nullptr;
+
+	Py_DECREF(spotModule);
+	formulaType = SWIG_TypeQuery("spot::formula *");
+
+	if (!formulaType) {
+		PyErr_SetString(PyExc_ImportError, "spot.formula is not known to the SWIG runtime");
+		return nullptr;
+	}
+
+	return PyModule_Create(&moduleDef);
+}
@@ -0,0 +1,257 @@
+/**
+ * @file renaming.cc
+ *
+ * In-memory cache of normal forms up to the renaming of atomic propositions.
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include "renaming.hh"
+
+using namespace std;
+using Op = Node::Op;
+
+/**
+ * Whether a node may be reached more than once when traversing a formula,
+ * so that its result must be memoized (the others have a single user).
+ */
+inline bool
+isShared(const Node* node)
+{
+	return node->isUnique() || node->refCount > 1;
+}
+
+/**
+ * Key of a template, which describes the structure of a formula in preorder,
+ * where the shared nodes already written are referred to by their numbers.
+ * Propositions are numbered in the order of their first occurrence (and
+ * collected in props).
+ */
+struct KeyWriter
+{
+	string key;
+	vector<Node*> props;
+	unordered_map<const Node*, uint32_t> numbers; // of shared nodes
+
+	void write(const Node* node);
+	void writeNumber(size_t number);
+};
+
+// Mark of a reference to a shared node (not an operator)
+constexpr char SHARED_REF = char(0xff);
+
+void
+KeyWriter::writeNumber(size_t number)
+{
+	// Numbers are written as varints
+	for (; number >= 0x80; number >>= 7)
+		key.push_back(char(number | 0x80));
+
+	key.push_back(char(number));
+}
+
+void
+KeyWriter::write(const Node* node)
+{
+	key.push_back(char(node->type));
+
+	// Formulae have few propositions, so they are looked up linearly
+	if (is(node, Op::APROP)) {
+		const size_t index = find(props.begin(), props.end(), node) - props.begin();
+		writeNumber(index);
+
+		if (index == props.size())
+			props.push_back(const_cast<Node*>(node));
+		return;
+	}
+
+	if (node->refCount > 1) {
+		auto [it, inserted] = numbers.emplace(node, numbers.size());
+
+		if (!inserted) {
+			key.back() = SHARED_REF;
+			writeNumber(it->second);
+			return;
+		}
+	}
+
+	if (is(node, Op::AND) || is(node, Op::OR))
+		writeNumber(node->children.size());
+
+	for (const Node* child : node->children)
+		write(child);
+}
+
+/**
+ * Rebuild a formula replacing some of its propositions (the rebuilt nodes
+ * are kept alive by the table). Every node is rebuilt, so that templates
+ * and instances never share nodes.
+ */
+Node*
+substitute(const Node* node, unordered_map<const Node*, Node*>& rebuilt,
+           vector<Node*>& table)
+{
+	const bool shared = isShared(node);
+
+	if (shared) {
+		auto it = rebuilt.find(node);
+
+		if (it != rebuilt.end())
+			return it->second;
+
+		if (node->isUnique())
+			return const_cast<Node*>(node);
+	}
+
+	NodeList args(node->children.size());
+
+	for (size_t i = 0; i < args.size(); ++i)
+		args[i] = substitute(node->children[i], rebuilt, table);
+
+	Node* result = Node::make(node->type, move(args));
+	result->addUser();
+	table.push_back(result);
+
+	if (shared)
+		rebuilt[node] = result;
+
+	return result;
+}
+
+RenamingCache::RenamingCache(size_t maxTemplates)
+  : maxTemplates(maxTemplates)
+{}
+
+Node*
+RenamingCache::normalizeComponent(Node* component, const Normalizer& normalizer)
+{
+	KeyWriter writer;
+	writer.write(component);
+	const vector<Node*>& props = writer.props;
+
+	NodeRef normal;
+	bool firstTwice = false;
+	vector<Node*> shapeProps;
+	{
+		lock_guard<std::mutex> guard(mutex);
+		auto it = templates.find(writer.key);
+		const bool inserted = it == templates.end();
+
+		if (inserted) {
+			if (templates.size() >= maxTemplates)
+				templates.clear();
+
+			it = templates.emplace(writer.key, Template()).first;
+		}
+
+		Template& entry = it->second;
+		entry.seen++;
+
+		normal = entry.normal;
+		firstTwice = entry.seen == 2;
+
+		// Templates are only built for the second instance, so that the
+		// formulae seen once are normalized directly
+		if (normal)
+			statistics.hits++;
+		else if (firstTwice || inserted)
+			statistics.misses++;
+		else
+			statistics.recomputed++;
+
+		while (templateProps.size() < props.size())
+			templateProps.push_back(Node::ap("p" + to_string(templateProps.size())));
+
+		shapeProps.assign(templateProps.begin(), templateProps.begin() + props.size());
+	}
+
+	if (!normal && !firstTwice)
+		return normalizer(component);
+
+	vector<Node*> table;
+	unordered_map<const Node*, Node*> rebuilt;
+	chrono::steady_clock::duration normalizing{};
+
+	// Templates are normalized without the lock (so the same template may
+	// be normalized concurrently by different threads, but only stored once)
+	if (!normal) {
+		for (size_t i = 0; i < props.size(); ++i)
+			rebuilt[props[i]] = shapeProps[i];
+
+		NodeRef shape(releaseTable(table, substitute(component, rebuilt, table)));
+		table.clear();
+		rebuilt.clear();
+
+		const auto start = chrono::steady_clock::now();
+		normal = NodeRef(normalizer(shape.get()));
+		normalizing = chrono::steady_clock::now() - start;
+	}
+
+	const auto start = chrono::steady_clock::now();
+
+	for (size_t i = 0; i < props.size(); ++i)
+		rebuilt[shapeProps[i]] = props[i];
+
+	Node* instance = releaseTable(table, substitute(normal.get(), rebuilt, table));
+
+	// The template is kept if instantiating it is faster than normalizing
+	if (firstTwice && chrono::steady_clock::now() - start < normalizing) {
+		lock_guard<std::mutex> guard(mutex);
+		auto it = templates.find(writer.key);
+
+		if (it != templates.end())
+			it->second.normal = normal;
+	}
+
+	return instance;
+}
+
+Node*
+RenamingCache::normalizeBoolean(Node* node, const Normalizer& normalizer,
+                                unordered_map<Node*, Node*>& rebuilt, vector<Node*>& table)
+{
+	// Formulae already in normal form (like constants and propositions)
+	// are left unchanged by the normalization
+	if (node->isNormal())
+		return node;
+
+	auto it = rebuilt.find(node);
+
+	if (it != rebuilt.end())
+		return it->second;
+
+	Node* result;
+
+	if (is(node, Op::AND) || is(node, Op::OR)) {
+		NodeList args(node->children.size());
+
+		for (size_t i = 0; i < args.size(); ++i)
+			args[i] = normalizeBoolean(node->children[i], normalizer, rebuilt, table);
+
+		result = Node::make(node->type, move(args));
+	} else
+		result = normalizeComponent(node, normalizer);
+
+	result->addUser();
+	table.push_back(result);
+
+	return rebuilt[node] = result;
+}
+
+Node*
+RenamingCache::normalize(Node* input, const Normalizer& normalizer)
+{
+	unordered_map<Node*, Node*> rebuilt;
+	vector<Node*> table;
+
+	return releaseTable(table, normalizeBoolean(input, normalizer, rebuilt, table));
+}
+
+RenamingCache::Stats
+RenamingCache::stats()
+{
+	lock_guard<std::mutex> guard(mutex);
+	statistics.templates = templates.size();
+	return statistics;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file renaming.hh
+ *
+ * In-memory cache of normal forms up to the renaming of atomic propositions.
+ *
+ * Generated specifications repeat the same formulae with different names,
+ * like G(r_i -> F g_i) for each client i of an arbiter, and the normalization
+ * commutes with the renaming of atomic propositions. Each component of the
+ * top-level Boolean structure of a formula is thus turned into a template,
+ * where its propositions are renamed p0, p1... in the order of their first
+ * occurrence, whose normal form is computed only once. The normal form of
+ * every instance is obtained by substituting its propositions back into the
+ * normal form of the template. This only pays off when the normalization of
+ * the template costs more than the substitution, which is measured on the
+ * second instance (the first one is normalized directly), so the instances
+ * of the other templates are normalized directly. Threads may share the
+ * cache.
+ */
+
+#ifndef RENAMING_HH
+#define RENAMING_HH
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tree.hh"
+
+class RenamingCache
+{
+	public:
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t recomputed = 0; // Instances of templates not worth keeping
+		size_t templates = 0;
+	};
+
+	using Normalizer = std::function<Node*(Node*)>;
+
+	/**
+	 * Create a cache holding up to the given number of templates (it is
+	 * emptied when full).
+	 */
+	explicit RenamingCache(size_t maxTemplates = 1 << 16);
+	RenamingCache(const RenamingCache&) = delete;
+
+	/**
+	 * Normalize a formula through the cache.
+	 *
+	 * @param normalizer Function normalizing the templates not in the cache.
+	 * @return The normal form (without users).
+	 */
+	Node* normalize(Node* input, const Normalizer& normalizer);
+
+	/**
+	 * Statistics of the usage of the cache.
+	 */
+	Stats stats();
+
+	private:
+	Node* normalizeComponent(Node* component, const Normalizer& normalizer);
+	Node* normalizeBoolean(Node* node, const Normalizer& normalizer,
+	                       std::unordered_map<Node*, Node*>& rebuilt,
+	                       std::vector<Node*>& table);
+
+	const size_t maxTemplates;
+
+	struct Template
+	{
+		// Normal form of the template, unless it is faster to normalize
+		// the instances than to instantiate it (as measured on the second
+		// instance)
+		NodeRef normal;
+		unsigned seen = 0; // Number of instances
+	};
+
+	// Templates indexed by their structure (see KeyWriter in renaming.cc)
+	std::unordered_map<std::string, Template> templates;
+	std::vector<Node*> templateProps; // Propositions p0, p1...
+
+	Stats statistics;
+	std::mutex mutex;
+};
+
+#endif // RENAMING_HH
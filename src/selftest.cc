@@ -0,0 +1,921 @@
+/**
+ * @file selftest.cc
+ *
+ * Focused tests of the subsystems around the normalizer (argument lists,
+ * formats, caches, renaming, server, sessions, parallel normalization,
+ * interfaces and cost estimation), complementing the equivalence checks of
+ * verify.cc.
+ *
+ * Each suite is run by giving its name as argument (or all of them without
+ * arguments), and failed checks are reported to the standard error.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "binio.hh"
+#include "cache.hh"
+#include "dagio.hh"
+#include "estimate.hh"
+#include "ltlnorm.h"
+#include "normalizer.hh"
+#include "renaming.hh"
+#include "server.hh"
+#include "session.hh"
+#include "threadpool.hh"
+#include "tree.hh"
+
+using namespace std;
+
+//
+//	Checks
+//
+
+size_t failures = 0;
+
+void
+check(bool condition, const string& what)
+{
+	if (!condition) {
+		cerr << "Error: " << what << ".\n";
+		failures++;
+	}
+}
+
+/**
+ * Capture what is written to the standard error during the lifetime of the
+ * object (errors expected by the tests).
+ */
+struct CapturedErrors
+{
+	CapturedErrors()
+	  : previous(cerr.rdbuf(captured.rdbuf()))
+	{}
+
+	~CapturedErrors() { cerr.rdbuf(previous); }
+
+	string text() const { return captured.str(); }
+
+	ostringstream captured;
+	streambuf* previous;
+};
+
+/**
+ * Temporary file removed at the end of the lifetime of the object.
+ */
+struct TempFile
+{
+	TempFile()
+	{
+		const char* dir = getenv("TMPDIR");
+		path = string(dir ? dir : "/tmp") + "/ltlnorm-selftest.XXXXXX";
+		fd = mkstemp(path.data());
+	}
+
+	~TempFile()
+	{
+		if (fd >= 0) {
+			close(fd);
+			unlink(path.c_str());
+		}
+	}
+
+	string path;
+	int fd;
+};
+
+/**
+ * Write a string to a pipe and return its reading end.
+ */
+int
+pipeWith(const string& contents)
+{
+	int fds[2];
+
+	if (pipe(fds) != 0)
+		return -1;
+
+	// The contents of the tests fit in the buffer of the pipe
+	if (write(fds[1], contents.data(), contents.size()) != ssize_t(contents.size())) {
+		close(fds[0]);
+		fds[0] = -1;
+	}
+
+	close(fds[1]);
+	return fds[0];
+}
+
+/**
+ * Whether the formula is written and read back as the same formula.
+ */
+bool
+dagRoundTrip(Node* formula)
+{
+	NodeRef original(formula);
+	ostringstream text, errors;
+	printDag(text, formula);
+
+	NodeRef parsed(parseDag(text.str(), errors));
+
+	if (!parsed) {
+		cerr << "Error: cannot read back " << text.str() << ": " << errors.str();
+		return false;
+	}
+
+	return *parsed.get() == *original.get();
+}
+
+//
+//	Lists of arguments (tree.hh)
+//
+
+void
+testNodeList()
+{
+	Node *a = Node::ap("a"), *b = Node::ap("b"), *c = Node::ap("c"), *d = Node::ap("d");
+
+	// Erasing down to empty from both ends of a list stored in the heap
+	NodeList list({ a, b, c, d });
+	list.erase(list.begin() + 1);
+	check(list.size() == 3 && list[0] == a && list[1] == c && list[2] == d,
+	      "erasing in the middle of a list");
+	list.erase(list.end() - 1);
+	list.erase(list.begin());
+	check(list.size() == 1 && list[0] == c && list.rbegin() + 1 == list.rend(),
+	      "erasing at both ends of a list");
+	list.erase(list.begin());
+	check(list.empty() && list.begin() == list.end() && list.rbegin() == list.rend(),
+	      "erasing the last argument of a list");
+
+	NodeList pair({ a, b });
+	pair.erase(pair.begin());
+	pair.erase(pair.begin());
+	check(pair.empty() && pair.rbegin() == pair.rend(),
+	      "erasing the arguments of an inline list");
+
+	// Constructors erasing all their arguments build empty nodes
+	NodeRef conjunction(Node::And({ Node::tt(), Node::tt(), Node::tt() }));
+	check(is(conjunction.get(), Node::Op::AND) && conjunction.get()->children.empty(),
+	      "conjunction of true");
+
+	NodeRef disjunction(Node::Or({ Node::ff(), Node::ff(), Node::ff(), Node::ff() }));
+	check(is(disjunction.get(), Node::Op::OR) && disjunction.get()->children.empty(),
+	      "disjunction of false");
+
+	check(Node::And({ Node::tt(), a, Node::tt() }) == a, "conjunction with a single argument");
+
+	NodeRef parsed(parseDag("tt;And 0 0 0"));
+	check(parsed && is(parsed.get(), Node::Op::AND) && parsed.get()->children.empty(),
+	      "conjunction of true read from a table");
+}
+
+//
+//	Shared-subformula tables (dagio.hh)
+//
+
+void
+testDagio()
+{
+	Node *a = Node::ap("a"), *b = Node::ap("b"), *c = Node::ap("c");
+
+	check(dagRoundTrip(Node::W(Node::U(a, b), Node::And({ c, Node::U(a, b) }))),
+	      "round trip of a shared formula");
+	check(dagRoundTrip(Node::And({ Node::GF(a), Node::FG(Node::X(b)), Node::Or({}) })),
+	      "round trip of GF, FG, X and empty disjunction");
+
+	// Names that need quoting and escaping
+	for (const char* name : { "a b", "a;b", "\"", "\\", "say \"hi\";", "x\\\";y", ";", "\\;" })
+		check(dagRoundTrip(Node::U(Node::ap(name), Node::R(a, Node::ap(name)))),
+		      string("round trip of the proposition ") + name);
+
+	NodeRef quoted(Node::U(Node::ap("a;b"), a));
+	ostringstream text;
+	printDag(text, quoted.get());
+	check(text.str() == "ap \"a;b\";ap a;U 0 1", "quoting of a name with a semicolon");
+
+	// Malformed tables are rejected
+	for (const char* table : { "", "foo", "ap", "U 0 1", "ap a;X 1", "ap a;U 0", "ap \"a",
+	                           "ap \"a;b", "ap \"a\" b", "ap a;;X 0" }) {
+		ostringstream errors;
+		check(parseDag(table, errors) == nullptr && !errors.str().empty(),
+		      string("rejection of the table ") + table);
+	}
+}
+
+//
+//	Binary batches (binio.hh)
+//
+
+/**
+ * Check that a batch read from a descriptor holds the given formulae.
+ */
+void
+checkBatch(int fd, const vector<NodeRef>& formulae, const string& what)
+{
+	BatchReader reader;
+
+	if (!reader.open(fd)) {
+		check(false, "opening the batch from " + what);
+		return;
+	}
+
+	check(reader.size() == formulae.size(), "number of formulae in the batch from " + what);
+
+	for (size_t i = 0; i < formulae.size() && i < reader.size(); ++i) {
+		NodeRef read(reader.get(i));
+
+		check(formulae[i] ? read && *read.get() == *formulae[i].get() : !read,
+		      "formula " + to_string(i) + " of the batch from " + what);
+	}
+}
+
+void
+testBinio()
+{
+	Node *a = Node::ap("a"), *b = Node::ap("b");
+	NodeRef shared(Node::U(a, b));
+
+	vector<NodeRef> formulae;
+	formulae.emplace_back(Node::W(shared.get(), Node::And({ Node::ap("c d"), shared.get() })));
+	formulae.emplace_back(nullptr);
+	formulae.emplace_back(Node::Or({ Node::GF(a), Node::FG(Node::X(b)), Node::And({}) }));
+	formulae.emplace_back(Node::tt());
+
+	BatchWriter writer;
+
+	for (const NodeRef& formula : formulae)
+		writer.add(formula.get());
+
+	ostringstream out;
+	check(writer.write(out) && writer.size() == formulae.size(), "writing a batch");
+	const string contents = out.str();
+
+	// Regular files are mapped into memory and pipes are read
+	TempFile file;
+	check(file.fd >= 0 && write(file.fd, contents.data(), contents.size()) == ssize_t(contents.size()),
+	      "writing the batch to a file");
+	checkBatch(file.fd, formulae, "a file");
+
+	int fd = pipeWith(contents);
+	checkBatch(fd, formulae, "a pipe");
+	close(fd);
+
+	// Empty, truncated and corrupted batches are rejected
+	string corrupted = contents;
+	corrupted[sizeof(binio::Header) + 4] = '\xff';
+
+	for (const string& bad : { string(), contents.substr(0, contents.size() - 1),
+	                           contents.substr(0, sizeof(binio::Header) / 2), corrupted }) {
+		CapturedErrors errors;
+		BatchReader reader;
+		int fd = pipeWith(bad);
+
+		check(!reader.open(fd) && !errors.text().empty() && reader.size() == 0,
+		      "rejection of a malformed batch of " + to_string(bad.size()) + " bytes");
+		close(fd);
+	}
+}
+
+//
+//	Persistent cache (cache.hh)
+//
+
+void
+testCache()
+{
+	TempFile file;
+	const string lockPath = file.path + ".lock";
+	PersistentCache cache(file.path, 1 << 20);
+	check(cache.open(), "opening the cache");
+
+	Node *a = Node::ap("a"), *b = Node::ap("b");
+	NodeRef input(Node::GF(Node::U(a, b))), output(Node::GF(b));
+	const PersistentCache::Key key = PersistentCache::key(input.get());
+
+	check(!cache.lookup(key), "lookup of a missing formula");
+	cache.store(key, output.get());
+
+	NodeRef found(cache.lookup(key));
+	check(found && *found.get() == *output.get(), "lookup of a stored formula");
+
+	// Inputs are compared to discard hash collisions
+	check(!cache.lookup({ key.hash, "ap c" }), "lookup of a colliding formula");
+
+	PersistentCache::Stats stats = cache.stats();
+	check(stats.hits == 1 && stats.misses == 2 && stats.stored == 1,
+	      "statistics of hits and misses");
+
+	// Records written by other users of the cache are found
+	{
+		PersistentCache other(file.path, 1 << 20);
+		check(other.open(), "opening the cache again");
+
+		NodeRef shared(other.lookup(key));
+		check(shared && *shared.get() == *output.get(), "lookup of a record of another user");
+	}
+
+	// Corrupt records are misses and they are replaced by the next store
+	NodeRef corruptInput(Node::FG(a));
+	const PersistentCache::Key corruptKey = PersistentCache::key(corruptInput.get());
+
+	ofstream(file.path, ios::app) << "R " << hex << corruptKey.hash << dec << " 1 "
+	                              << corruptKey.text << "\tU 0 1\n";
+
+	stats = cache.stats();
+	check(!cache.lookup(corruptKey), "lookup of a corrupt record");
+	check(cache.stats().hits == stats.hits && cache.stats().misses == stats.misses + 1,
+	      "statistics of a corrupt record");
+
+	cache.store(corruptKey, a);
+	NodeRef repaired(cache.lookup(corruptKey));
+	check(repaired && repaired.get() == a, "replacement of a corrupt record");
+
+	// The least recently used records are evicted when the cache is full
+	{
+		TempFile smallFile;
+		PersistentCache small(smallFile.path, 2048);
+		check(small.open(), "opening a small cache");
+
+		vector<PersistentCache::Key> keys;
+
+		for (unsigned i = 0; i < 100; ++i) {
+			NodeRef formula(Node::U(Node::ap("p" + to_string(i)), b));
+			keys.push_back(PersistentCache::key(formula.get()));
+			small.store(keys.back(), formula.get());
+		}
+
+		check(small.stats().evicted > 0, "eviction of records");
+		check(!NodeRef(small.lookup(keys.front())), "eviction of the oldest record");
+		check(bool(NodeRef(small.lookup(keys.back()))), "keeping the newest record");
+
+		ifstream stored(smallFile.path, ios::ate);
+		check(size_t(stored.tellg()) <= 2048, "size of the compacted cache");
+		unlink((smallFile.path + ".lock").c_str());
+	}
+
+	unlink(lockPath.c_str());
+}
+
+//
+//	Server (server.hh)
+//
+
+/**
+ * Normal form of a formula as written by the server.
+ */
+string
+normalForm(const string& text)
+{
+	NodeRef input(readFormula(text, Format::SPOT));
+	NodeRef output(normalize(input.get()));
+	return writeFormula(output.get(), Format::SPOT);
+}
+
+/**
+ * Send some text to the server in a new connection, close its writing end
+ * and collect the responses by identifier until the server closes it.
+ */
+map<string, string>
+sendRequests(const string& socketPath, const string& text)
+{
+	map<string, string> responses;
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socketPath.c_str());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0 || connect(fd, (sockaddr*) &address, sizeof(address)) != 0) {
+		check(false, "connection to the server");
+		close(fd);
+		return responses;
+	}
+
+	// Requests are written whole before reading, as pipelining clients do
+	size_t written = 0;
+	ssize_t count;
+
+	while (written < text.size() &&
+	       (count = write(fd, text.data() + written, text.size() - written)) > 0)
+		written += count;
+
+	shutdown(fd, SHUT_WR);
+
+	string received;
+	char buffer[4096];
+
+	while ((count = read(fd, buffer, sizeof(buffer))) > 0)
+		received.append(buffer, count);
+
+	close(fd);
+
+	istringstream in(received);
+	string line;
+
+	while (getline(in, line)) {
+		const size_t space = line.find(' ');
+		responses[line.substr(0, space)] = space == string::npos ? "" : line.substr(space + 1);
+	}
+
+	return responses;
+}
+
+void
+testServer()
+{
+	TempFile file;
+	const string socketPath = file.path + ".sock";
+
+	ServerOptions options;
+	options.threads = 2;
+	options.maxRequest = 4096;
+
+	thread server([&] { runServer(socketPath.c_str(), options); });
+
+	// The server is ready when its socket exists
+	for (unsigned i = 0; i < 500 && access(socketPath.c_str(), F_OK) != 0; ++i)
+		this_thread::sleep_for(chrono::milliseconds(10));
+
+	// Pipelined requests, answered in any order, with errors and a last
+	// request without a line break
+	map<string, string> responses =
+	  sendRequests(socketPath, "1 a U b\n2 GF(a U (b W c))\n\n3 (a U\n4\n5 FG(a W b)");
+
+	check(responses.size() == 5, "number of responses to pipelined requests");
+	check(responses["1"] == normalForm("a U b"), "response to a request");
+	check(responses["2"] == normalForm("GF(a U (b W c))"), "response to a pipelined request");
+	check(responses["3"].rfind("!", 0) == 0, "response to a malformed formula");
+	check(responses["4"] == "!missing formula", "response to a request without formula");
+	check(responses["5"] == normalForm("FG(a W b)"), "response to a last request without line break");
+
+	// Oversized requests are rejected, whether complete or not, and the
+	// following requests are still answered
+	const string longName(5000, 'p');
+	responses = sendRequests(socketPath, "6 " + longName + "\n7 X a\n8 " + longName + longName +
+	                                   longName + "\n9 F a\n10 " + longName);
+
+	check(responses.size() == 5, "number of responses with oversized requests");
+	check(responses["6"] == "!request longer than 4096 bytes", "rejection of an oversized request");
+	check(responses["7"] == normalForm("X a"), "response after an oversized request");
+	check(responses["8"] == "!request longer than 4096 bytes",
+	      "rejection of an oversized request read in parts");
+	check(responses["9"] == normalForm("F a"), "response after an oversized request read in parts");
+	check(responses["10"] == "!request longer than 4096 bytes",
+	      "rejection of an oversized last request");
+
+	// The server stops on termination signals
+	kill(getpid(), SIGTERM);
+	server.join();
+	check(access(socketPath.c_str(), F_OK) != 0, "removal of the socket");
+}
+
+//
+//	Renaming cache (renaming.hh)
+//
+
+/**
+ * Normalize a formula through a renaming cache and write its normal form.
+ */
+string
+renamedNormalForm(RenamingCache& cache, const string& text,
+                  const RenamingCache::Normalizer& normalizer)
+{
+	NodeRef input(readFormula(text, Format::SPOT));
+	NodeRef output(cache.normalize(input.get(), normalizer));
+	return writeFormula(output.get(), Format::SPOT);
+}
+
+void
+testRenaming()
+{
+	// The normalizer is slowed down so that the templates are kept
+	unsigned calls = 0;
+	const RenamingCache::Normalizer slow = [&calls](Node* formula) {
+		calls++;
+		this_thread::sleep_for(chrono::milliseconds(20));
+		return normalize(formula);
+	};
+
+	RenamingCache cache;
+
+	// The first instance is normalized directly and the second builds the
+	// template, which the others instantiate
+	const string instances[] = { "G(r1 -> F g1)", "G(r2 -> F g2)", "G(r3 -> F g3)",
+		                         "G(req -> F grant)" };
+
+	for (const string& instance : instances)
+		check(renamedNormalForm(cache, instance, slow) == normalForm(instance),
+		      "normal form of the instance " + instance);
+
+	RenamingCache::Stats stats = cache.stats();
+	check(calls == 2, "normalization of the first instance and the template only");
+	check(stats.hits == 2 && stats.misses == 2 && stats.recomputed == 0 && stats.templates == 1,
+	      "statistics of the instances of a template");
+
+	// Each component of the top-level Boolean structure is an instance
+	const string combined = "G(r5 -> F g5) & (G(r6 -> F g6) | a)";
+	check(renamedNormalForm(cache, combined, slow) == normalForm(combined),
+	      "normal form of a Boolean combination of instances");
+	check(calls == 2 && cache.stats().hits == stats.hits + 2,
+	      "instantiation of the components");
+
+	// Formulae in normal form are not looked up
+	check(renamedNormalForm(cache, "GF a & Fb", slow) == normalForm("GF a & Fb") &&
+	        calls == 2,
+	      "normal form of a normal formula");
+
+	// The cache is emptied when full
+	RenamingCache small(1);
+	renamedNormalForm(small, "a W (b U c)", slow);
+	renamedNormalForm(small, "G(r1 -> F g1)", slow);
+	stats = small.stats();
+	check(stats.templates == 1 && stats.misses == 2, "capacity of the cache");
+}
+
+//
+//	Sessions (session.hh)
+//
+
+/**
+ * Normal form of a formula held by a session (or an empty string).
+ */
+string
+writeNormal(Node* formula)
+{
+	return formula ? writeFormula(formula, Format::SPOT) : "";
+}
+
+void
+testSession()
+{
+	unsigned calls = 0;
+	Session session([&calls](Node* formula) {
+		calls++;
+		return normalize(formula);
+	});
+
+	check(session.normalForm() == Node::tt() && session.size() == 0,
+	      "normal form of an empty session");
+
+	session.set("a", readFormula("a W (b U c)", Format::SPOT));
+	session.set("b", readFormula("G(r -> F g)", Format::SPOT));
+	session.set("c", readFormula("X d", Format::SPOT));
+
+	check(session.size() == 3 && calls == 3, "addition of conjuncts");
+	check(writeNormal(session.normalForm("b")) == normalForm("G(r -> F g)"),
+	      "normal form of a conjunct");
+	check(writeNormal(session.normalForm()) ==
+	        normalForm("(a W (b U c)) & G(r -> F g) & X d"),
+	      "normal form of the specification");
+
+	// The normal form is kept until the next edit
+	Node* previous = session.normalForm();
+	check(session.normalForm() == previous && calls == 3, "reuse of the normal form");
+
+	// Only the new formula is normalized, and it keeps the position of the
+	// replaced conjunct
+	session.set("a", readFormula("GF e", Format::SPOT));
+	check(session.size() == 3 && calls == 4, "replacement of a conjunct");
+	check(writeNormal(session.normalForm()) == normalForm("GF e & G(r -> F g) & X d"),
+	      "normal form after a replacement");
+
+	check(!session.remove("d") && session.size() == 3, "removal of a missing conjunct");
+	check(session.remove("b") && session.size() == 2 && !session.normalForm("b"),
+	      "removal of a conjunct");
+	check(writeNormal(session.normalForm()) == normalForm("GF e & X d") && calls == 4,
+	      "normal form after a removal");
+
+	// Removed names are added again at the end
+	session.set("b", readFormula("F f", Format::SPOT));
+	check(writeNormal(session.normalForm()) == normalForm("GF e & X d & F f") &&
+	        calls == 5,
+	      "addition of a removed conjunct");
+
+	session.clear();
+	check(session.size() == 0 && session.normalForm() == Node::tt() &&
+	        !session.normalForm("a"),
+	      "clearing the session");
+}
+
+//
+//	Parallel normalization (normalizer.hh)
+//
+
+/**
+ * Check that the normal form of a table is the same when normalized with
+ * and without a thread pool.
+ */
+void
+checkParallel(const string& table, ThreadPool& pool, const string& what)
+{
+	NodeRef sequentialInput(parseDag(table)), parallelInput(parseDag(table));
+	check(sequentialInput && parallelInput, "reading the table of " + what);
+
+	if (!sequentialInput || !parallelInput)
+		return;
+
+	NodeRef sequential(normalize(sequentialInput.get()));
+	NodeRef parallel(normalize(parallelInput.get(), &pool));
+	check(*parallel.get() == *sequential.get(), "parallel normal form of " + what);
+}
+
+void
+testParallel()
+{
+	ThreadPool pool(2);
+
+	// Independent components a_i W (b_i U c_i) (large enough to be split)
+	ostringstream independent;
+
+	for (unsigned i = 0; i < 40; ++i)
+		independent << "ap a" << i << ";ap b" << i << ";ap c" << i << ";U " << 5 * i + 1 << " "
+		            << 5 * i + 2 << ";W " << 5 * i << " " << 5 * i + 3 << ";";
+
+	independent << "Or";
+
+	for (unsigned i = 0; i < 40; ++i)
+		independent << " " << 5 * i + 4;
+
+	checkParallel(independent.str(), pool, "independent components");
+
+	// (b U GF c) & (d U GF e) is both a conjunction of the top-level structure
+	// and the argument of a component, whose normalization rewrites it in place
+	ostringstream shared;
+	shared << "ap a;ap b;ap c;ap d;ap e;GF 2;GF 4;U 1 5;U 3 6;And 7 8;GF 0;U 10 9;"
+	          "ap f;ap g;U 12 13;X 14";
+
+	for (unsigned i = 15; i < 84; ++i)
+		shared << ";X " << i;
+
+	shared << ";Or 9 11 84";
+
+	checkParallel(shared.str(), pool, "a component containing a top-level conjunction");
+}
+
+//
+//	C interface (ltlnorm.h)
+//
+
+void
+testCapi()
+{
+	char buffer[4096];
+	size_t length = 0;
+
+	// Missing arguments
+	check(ltlnorm_normalize(nullptr, "a", buffer, sizeof(buffer), &length) == LTLNORM_BAD_ARGUMENT,
+	      "normalization without context");
+	check(string(ltlnorm_last_error(nullptr)).empty(), "last error without context");
+
+	ltlnorm_context* context = ltlnorm_create(nullptr);
+	check(context != nullptr, "creation of a context with the default options");
+
+	check(ltlnorm_normalize(context, nullptr, buffer, sizeof(buffer), &length) ==
+	        LTLNORM_BAD_ARGUMENT,
+	      "normalization without formula");
+	check(ltlnorm_normalize(context, "a", nullptr, 10, &length) == LTLNORM_BAD_ARGUMENT,
+	      "normalization without buffer");
+	check(ltlnorm_estimate(context, nullptr, nullptr, nullptr) == LTLNORM_BAD_ARGUMENT,
+	      "estimation without formula");
+
+	// Malformed formulae keep their error until the next success
+	check(ltlnorm_normalize(context, "a U", buffer, sizeof(buffer), &length) == LTLNORM_BAD_INPUT,
+	      "normalization of a malformed formula");
+	check(!string(ltlnorm_last_error(context)).empty(), "error of a malformed formula");
+	check(ltlnorm_estimate(context, "(a", nullptr, nullptr) == LTLNORM_BAD_INPUT,
+	      "estimation of a malformed formula");
+
+	const string expected = normalForm("GF(a U b)");
+	check(ltlnorm_normalize(context, "GF(a U b)", buffer, sizeof(buffer), &length) == LTLNORM_OK &&
+	        buffer == expected && length == expected.size(),
+	      "normalization of a formula");
+	check(string(ltlnorm_last_error(context)).empty(), "error cleared by a success");
+
+	// Buffers too small report the required size
+	length = 0;
+	check(ltlnorm_normalize(context, "GF(a U b)", nullptr, 0, &length) == LTLNORM_TOO_SMALL &&
+	        length == expected.size() + 1,
+	      "required size without buffer");
+	check(ltlnorm_normalize(context, "GF(a U b)", buffer, expected.size(), &length) ==
+	          LTLNORM_TOO_SMALL &&
+	        length == expected.size() + 1,
+	      "required size with a small buffer");
+	check(ltlnorm_normalize(context, "GF(a U b)", buffer, expected.size() + 1, nullptr) ==
+	          LTLNORM_OK &&
+	        buffer == expected,
+	      "normalization into a buffer of the exact size");
+
+	// Batches report the status of each formula and stop when full
+	const char* formulae[] = { "a U b", nullptr, "(a", "GF(a U b)" };
+	size_t offsets[4];
+	ltlnorm_status statuses[4];
+
+	check(ltlnorm_normalize_batch(context, formulae, 4, buffer, sizeof(buffer), offsets,
+	                              statuses) == 4,
+	      "normalization of a batch");
+	check(statuses[0] == LTLNORM_OK && statuses[1] == LTLNORM_BAD_ARGUMENT &&
+	        statuses[2] == LTLNORM_BAD_INPUT && statuses[3] == LTLNORM_OK,
+	      "statuses of a batch");
+	check(buffer + offsets[0] == normalForm("a U b") && buffer[offsets[1]] == '\0' &&
+	        buffer[offsets[2]] == '\0' && buffer + offsets[3] == expected,
+	      "results of a batch");
+	check(string(ltlnorm_last_error(context)).empty(), "errors of a batch not kept");
+	check(ltlnorm_normalize_batch(context, formulae, 4, buffer, normalForm("a U b").size() + 2,
+	                              offsets, statuses) == 2 &&
+	        statuses[2] == LTLNORM_TOO_SMALL,
+	      "batch stopped by a small buffer");
+	check(ltlnorm_normalize_batch(context, nullptr, 4, buffer, sizeof(buffer), offsets,
+	                              statuses) == 0,
+	      "batch without formulae");
+
+	// Sessions
+	ltlnorm_session* session = ltlnorm_session_create(context);
+	check(ltlnorm_session_set(session, "a", "(a") == LTLNORM_BAD_INPUT,
+	      "malformed conjunct of a session");
+	check(ltlnorm_session_set(session, nullptr, "a") == LTLNORM_BAD_ARGUMENT,
+	      "conjunct of a session without name");
+	check(ltlnorm_session_remove(session, "missing") == LTLNORM_BAD_ARGUMENT,
+	      "removal of a missing conjunct");
+	check(ltlnorm_session_normal_form(session, buffer, sizeof(buffer), &length) == LTLNORM_OK &&
+	        buffer == normalForm("1"),
+	      "normal form of an empty session");
+	ltlnorm_session_destroy(session);
+	ltlnorm_destroy(context);
+
+	check(ltlnorm_session_create(nullptr) == nullptr, "session without context");
+
+	// Limits on the cost and bad caches
+	ltlnorm_options options;
+	ltlnorm_default_options(&options);
+	options.max_work = 1;
+	context = ltlnorm_create(&options);
+
+	check(ltlnorm_normalize(context, "GF(a U (b W c))", buffer, sizeof(buffer), &length) ==
+	          LTLNORM_TOO_EXPENSIVE &&
+	        !string(ltlnorm_last_error(context)).empty(),
+	      "rejection of an expensive formula");
+	ltlnorm_destroy(context);
+
+	ltlnorm_default_options(&options);
+	options.cache_path = "/nonexistent/ltlnorm-selftest/cache";
+	{
+		CapturedErrors errors;
+		check(ltlnorm_create(&options) == nullptr && !errors.text().empty(),
+		      "creation of a context with an inaccessible cache");
+	}
+
+	// Tables of shared subformulae
+	ltlnorm_default_options(&options);
+	options.input = LTLNORM_DAG;
+	options.output = LTLNORM_DAG;
+	context = ltlnorm_create(&options);
+
+	check(ltlnorm_normalize(context, "ap a;U 0 1", buffer, sizeof(buffer), &length) ==
+	        LTLNORM_BAD_INPUT,
+	      "normalization of a malformed table");
+	check(ltlnorm_normalize(context, "ap a;ap b;U 0 1", buffer, sizeof(buffer), &length) ==
+	          LTLNORM_OK &&
+	        string(buffer) == "ap a;ap b;U 0 1",
+	      "normalization of a table");
+	ltlnorm_destroy(context);
+}
+
+//
+//	Cost estimation (estimate.hh)
+//
+
+struct SampleFile
+{
+	const char* path;     // Relative to the source directory
+	double medianFactor; // Bound on the median ratio of the estimated size to the actual
+};
+
+const SampleFile sampleFiles[] = {
+	{ "tests/random1000.spot", 2 },
+	{ "tests/random1000_norm.spot", 2 },
+	{ "tests/random1000_notdelta2.spot", 8 },
+	{ "tests/random1000_notnorm.spot", 8 },
+	{ "tests/tlsf21_100.spot", 2 },
+	{ "tests/tlsf21_300.spot", 2 },
+	{ "tests/uw.spot", 30 },
+	{ "tests/uwuw.spot", 30 },
+	{ "tests/wu.spot", 3 },
+};
+
+// Bound on the ratio of the estimated size to the actual for every formula
+constexpr double maxFactor = 1e7;
+
+void
+testEstimate()
+{
+	for (const SampleFile& sample : sampleFiles) {
+		ifstream file(sample.path);
+		check(file.good(), string("opening ") + sample.path);
+
+		vector<double> factors;
+		string line;
+
+		for (size_t number = 1; getline(file, line); ++number) {
+			if (line.empty())
+				continue;
+
+			const string where = string(sample.path) + ":" + to_string(number);
+			NodeRef input(readFormula(line, Format::SPOT));
+			check(bool(input), "reading " + where);
+
+			if (!input)
+				continue;
+
+			const double estimate = estimateCost(input.get()).outputSize;
+			NodeRef output(normalize(input.get()));
+			const double size = treeSize(output.get());
+
+			check(estimate >= size, "estimated size " + to_string(estimate) +
+			                          " below the actual " + to_string(size) + " at " + where);
+			factors.push_back((estimate + 1) / (size + 1));
+		}
+
+		if (factors.empty())
+			continue;
+
+		sort(factors.begin(), factors.end());
+		const double median = factors[factors.size() / 2];
+
+		check(median <= sample.medianFactor, "median overestimate " + to_string(median) +
+		                                       " in " + sample.path);
+		check(factors.back() <= maxFactor, "overestimate " + to_string(factors.back()) +
+		                                     " in " + sample.path);
+	}
+}
+
+//
+//	Test runner
+//
+
+struct Suite
+{
+	const char* name;
+	void (*run)();
+};
+
+const Suite suites[] = {
+	{ "nodelist", testNodeList },
+	{ "dagio", testDagio },
+	{ "binio", testBinio },
+	{ "cache", testCache },
+	{ "server", testServer },
+	{ "renaming", testRenaming },
+	{ "session", testSession },
+	{ "parallel", testParallel },
+	{ "capi", testCapi },
+	{ "estimate", testEstimate },
+};
+
+int
+main(int argc, char* argv[])
+{
+	vector<const Suite*> selected;
+
+	for (int i = 1; i < argc; ++i) {
+		const Suite* found = nullptr;
+
+		for (const Suite& suite : suites)
+			if (strcmp(argv[i], suite.name) == 0)
+				found = &suite;
+
+		if (!found) {
+			cerr << "Error: unknown test suite " << argv[i] << ".\n";
+			return 1;
+		}
+
+		selected.push_back(found);
+	}
+
+	if (selected.empty())
+		for (const Suite& suite : suites)
+			selected.push_back(&suite);
+
+	for (const Suite* suite : selected) {
+		const size_t before = failures;
+		suite->run();
+		cout << suite->name << ": " << (failures == before ? "ok" : "failed") << "\n";
+	}
+
+	Node::releaseStaticNodes();
+
+	return failures == 0 ? 0 : 1;
+}
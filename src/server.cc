@@ -0,0 +1,389 @@
+/**
+ * @file server.cc
+ *
+ * Server normalizing formulae for clients connected to a Unix socket.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "estimate.hh"
+#include "server.hh"
+#include "threadpool.hh"
+
+using namespace std;
+
+// Pipe to wake up the event loop (from the workers and signal handlers)
+int wakeupFd = -1;
+volatile sig_atomic_t stopRequested = 0;
+
+void
+requestStop(int)
+{
+	stopRequested = 1;
+	[[maybe_unused]] ssize_t count = write(wakeupFd, "", 1);
+}
+
+struct Client
+{
+	int fd;
+	string input;       // Received text not yet processed
+	string output;      // Responses not yet sent
+	size_t pending = 0; // Requests being normalized
+	bool closing = false;
+	bool discarding = false; // Skipping the rest of an oversized request
+};
+
+class Server
+{
+	public:
+	Server(const ServerOptions& options);
+	~Server();
+
+	bool listen(const char* socketPath);
+	void run();
+
+	private:
+	void accept();
+	bool receive(uint64_t clientId, Client& client);
+	void splitRequests(uint64_t clientId, Client& client);
+	void submit(uint64_t clientId, Client& client, string request);
+	bool send(Client& client);
+	void collectResponses();
+	string handle(const string& request);
+
+	const ServerOptions& options;
+	int listenFd = -1;
+	int wakeupRead = -1;
+	map<uint64_t, Client> clients;
+	uint64_t nextClientId = 0;
+
+	// Responses completed by the workers
+	mutex responsesMutex;
+	vector<pair<uint64_t, string>> responses;
+
+	ThreadPool pool;
+};
+
+Server::Server(const ServerOptions& options)
+  : options(options)
+  , pool(options.threads)
+{}
+
+Server::~Server()
+{
+	// Workers may still be writing responses
+	pool.wait();
+
+	for (auto& [id, client] : clients)
+		close(client.fd);
+
+	if (listenFd >= 0)
+		close(listenFd);
+
+	if (wakeupRead >= 0) {
+		close(wakeupRead);
+		close(wakeupFd);
+	}
+}
+
+bool
+Server::listen(const char* socketPath)
+{
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+
+	if (strlen(socketPath) >= sizeof(address.sun_path)) {
+		cerr << "Error: socket path " << socketPath << " is too long.\n";
+		return false;
+	}
+
+	strcpy(address.sun_path, socketPath);
+
+	// A socket left by a previous server is replaced
+	struct stat info;
+
+	if (stat(socketPath, &info) == 0 && S_ISSOCK(info.st_mode))
+		unlink(socketPath);
+
+	int pipeFds[2];
+	listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	if (listenFd < 0 || bind(listenFd, (sockaddr*) &address, sizeof(address)) != 0 ||
+	    ::listen(listenFd, SOMAXCONN) != 0 || pipe2(pipeFds, O_NONBLOCK | O_CLOEXEC) != 0) {
+		cerr << "Error: cannot listen on " << socketPath << ": " << strerror(errno) << ".\n";
+		return false;
+	}
+
+	wakeupRead = pipeFds[0];
+	wakeupFd = pipeFds[1];
+
+	return true;
+}
+
+void
+Server::run()
+{
+	signal(SIGINT, requestStop);
+	signal(SIGTERM, requestStop);
+
+	vector<pollfd> polled;
+	vector<uint64_t> polledIds;
+
+	while (!stopRequested) {
+		polled = { { listenFd, POLLIN, 0 }, { wakeupRead, POLLIN, 0 } };
+		polledIds.clear();
+
+		for (auto& [id, client] : clients) {
+			short events = client.closing ? 0 : POLLIN;
+
+			if (!client.output.empty())
+				events |= POLLOUT;
+
+			polled.push_back({ client.fd, events, 0 });
+			polledIds.push_back(id);
+		}
+
+		if (poll(polled.data(), polled.size(), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (polled[1].revents & POLLIN)
+			collectResponses();
+
+		if (polled[0].revents & POLLIN)
+			accept();
+
+		for (size_t i = 0; i < polledIds.size(); ++i) {
+			auto it = clients.find(polledIds[i]);
+			const short events = polled[i + 2].revents;
+			// A hang up after the end of the input means that the client
+			// has closed the connection completely
+			bool alive = !(events & (POLLERR | POLLNVAL)) &&
+			             !((events & POLLHUP) && it->second.closing);
+
+			if (alive && (events & (POLLIN | POLLHUP)) && !it->second.closing)
+				alive = receive(it->first, it->second);
+
+			if (alive && (events & POLLOUT))
+				alive = send(it->second);
+
+			// Clients are closed when they have sent everything and all
+			// their responses have been sent (or they cannot be sent)
+			if (!alive || (it->second.closing && it->second.pending == 0 &&
+			               it->second.output.empty())) {
+				close(it->second.fd);
+				clients.erase(it);
+			}
+		}
+	}
+}
+
+void
+Server::accept()
+{
+	int fd;
+
+	while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+		clients.emplace(nextClientId++, Client{ fd, {}, {}, 0, false, false });
+}
+
+bool
+Server::receive(uint64_t clientId, Client& client)
+{
+	char buffer[1 << 16];
+	ssize_t count;
+
+	// Requests are split as they are read, so that the input kept for
+	// each client is bounded by the maximum length of a request
+	while ((count = read(client.fd, buffer, sizeof(buffer))) > 0) {
+		client.input.append(buffer, count);
+		splitRequests(clientId, client);
+	}
+
+	if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+		return false;
+
+	// The client will not send more requests, and the last one may not
+	// be followed by a line break
+	if (count == 0) {
+		client.closing = true;
+
+		if (!client.discarding)
+			submit(clientId, client, move(client.input));
+
+		client.input.clear();
+	}
+
+	return true;
+}
+
+void
+Server::splitRequests(uint64_t clientId, Client& client)
+{
+	// Each complete line is a request
+	size_t start = 0, end;
+
+	while ((end = client.input.find('\n', start)) != string::npos) {
+		string request = client.input.substr(start, end - start);
+		start = end + 1;
+
+		// The end of an oversized request has been reached
+		if (client.discarding)
+			client.discarding = false;
+		else
+			submit(clientId, client, move(request));
+	}
+
+	client.input.erase(0, start);
+
+	// An incomplete request already too long is answered now and the rest
+	// of its line is skipped
+	if (!client.discarding && client.input.size() > options.maxRequest) {
+		submit(clientId, client, move(client.input));
+		client.input.clear();
+		client.discarding = true;
+	} else if (client.discarding)
+		client.input.clear();
+}
+
+void
+Server::submit(uint64_t clientId, Client& client, string request)
+{
+	if (request.empty())
+		return;
+
+	if (request.size() > options.maxRequest) {
+		// The identifier is only echoed if it is a reasonable word
+		const size_t space = request.find(' ');
+		const string id = space <= 256 ? request.substr(0, space) : string();
+
+		client.output += id + " !request longer than " + to_string(options.maxRequest) +
+		                 " bytes\n";
+		return;
+	}
+
+	client.pending++;
+
+	pool.submit([this, clientId, request = move(request)] {
+		string response = handle(request);
+		{
+			lock_guard<mutex> lock(responsesMutex);
+			responses.emplace_back(clientId, move(response));
+		}
+		[[maybe_unused]] ssize_t count = write(wakeupFd, "", 1);
+	});
+}
+
+bool
+Server::send(Client& client)
+{
+	ssize_t count = ::send(client.fd, client.output.data(), client.output.size(), MSG_NOSIGNAL);
+
+	if (count < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK;
+
+	client.output.erase(0, count);
+	return true;
+}
+
+void
+Server::collectResponses()
+{
+	char buffer[256];
+
+	while (read(wakeupRead, buffer, sizeof(buffer)) > 0)
+		;
+
+	vector<pair<uint64_t, string>> completed;
+	{
+		lock_guard<mutex> lock(responsesMutex);
+		completed.swap(responses);
+	}
+
+	// Responses for clients that have disconnected are discarded
+	for (auto& [clientId, response] : completed) {
+		auto it = clients.find(clientId);
+
+		if (it != clients.end()) {
+			it->second.output += response;
+			it->second.pending--;
+		}
+	}
+}
+
+string
+Server::handle(const string& request)
+{
+	const size_t space = request.find(' ');
+	const string id = request.substr(0, space);
+
+	if (space == string::npos)
+		return id + " !missing formula\n";
+
+	ostringstream errors;
+	NodeRef input(readFormula(request.substr(space + 1), options.input, errors));
+
+	if (!input) {
+		string message = errors.str();
+
+		while (!message.empty() && message.back() == '\n')
+			message.pop_back();
+
+		for (char& c : message)
+			if (c == '\n')
+				c = ' ';
+
+		return id + " !" + message + "\n";
+	}
+
+	// The cost is estimated after the simplification, which may reduce it
+	input = NodeRef(simplifyFormula(input.get(), options.simplify));
+
+	if (options.maxWork > 0) {
+		const CostEstimate estimate = estimateCost(input.get());
+
+		if (estimate.work > options.maxWork) {
+			ostringstream message;
+			message << id << " !estimated work " << estimate.work << " exceeds the limit\n";
+			return message.str();
+		}
+	}
+
+	NodeRef output(normalizeCached(input.get(), options.cache, options.split ? &pool : nullptr,
+	                               options.renaming));
+
+	return id + " " + writeFormula(output.get(), options.output) + "\n";
+}
+
+bool
+runServer(const char* socketPath, const ServerOptions& options)
+{
+	if (options.input == Format::BINARY || options.output == Format::BINARY) {
+		cerr << "Error: the binary format cannot be used in server mode.\n";
+		return false;
+	}
+
+	Server server(options);
+
+	if (!server.listen(socketPath))
+		return false;
+
+	server.run();
+	unlink(socketPath);
+
+	return true;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file server.hh
+ *
+ * Server normalizing formulae for clients connected to a Unix socket.
+ *
+ * Clients send requests as lines "<id> <formula>", where the identifier is
+ * any word chosen by the client, and receive lines "<id> <normal form>" or
+ * "<id> !<error message>". Clients may send any number of requests without
+ * waiting for the responses, which are sent as soon as they are ready, so
+ * possibly not in the order of the requests. Requests are handled by a pool
+ * of threads sharing the table of atomic propositions and the cache.
+ * Formulae whose estimated cost exceeds a limit are rejected before being
+ * normalized, so that a single formula cannot stall a worker, and so are
+ * requests longer than a maximum length, so that a single client cannot
+ * exhaust the memory. The last request may not end with a line break.
+ */
+
+#ifndef SERVER_HH
+#define SERVER_HH
+
+#include "cache.hh"
+#include "pipeline.hh"
+
+struct ServerOptions
+{
+	Format input = Format::SPOT;
+	Format output = Format::SPOT;
+	PersistentCache* cache = nullptr; // Optional cache of normal forms
+	RenamingCache* renaming = nullptr; // Optional cache up to renaming
+	unsigned threads = 0;             // Worker threads (0 for all available)
+	bool split = false; // Normalize the components of large formulae in parallel
+	double maxWork = 0; // Reject formulae estimated to cost more (0 for no limit)
+	unsigned simplify = 0; // Level of simplification (see simplifyFormula)
+	size_t maxRequest = 1 << 24; // Maximum length of a request in bytes
+};
+
+/**
+ * Serve requests on the Unix socket at the given path until the process
+ * is interrupted or terminated.
+ *
+ * @return Whether the server could be started. Otherwise, the error is
+ * reported to the standard error.
+ */
+bool runServer(const char* socketPath, const ServerOptions& options);
+
+#endif // SERVER_HH
@@ -0,0 +1,86 @@
+/**
+ * @file session.cc
+ *
+ * Specification held as a conjunction of named formulae, which is kept
+ * normalized while its conjuncts are added, replaced and removed.
+ */
+
+#include "session.hh"
+
+using namespace std;
+
+Session::Session(Normalizer normalizer)
+  : normalizer(move(normalizer))
+{}
+
+void
+Session::set(const string& name, Node* formula)
+{
+	NodeRef normal;
+	{
+		NodeRef input(formula);
+		normal = NodeRef(normalizer(input.get()));
+	}
+
+	auto [it, inserted] = positions.emplace(name, conjuncts.size());
+
+	if (inserted)
+		conjuncts.push_back({ name, move(normal) });
+	else
+		conjuncts[it->second].normal = move(normal);
+
+	conjunction = NodeRef();
+}
+
+bool
+Session::remove(const string& name)
+{
+	auto it = positions.find(name);
+
+	if (it == positions.end())
+		return false;
+
+	const size_t position = it->second;
+	conjuncts.erase(conjuncts.begin() + position);
+	positions.erase(it);
+
+	for (size_t i = position; i < conjuncts.size(); ++i)
+		positions[conjuncts[i].name] = i;
+
+	conjunction = NodeRef();
+	return true;
+}
+
+void
+Session::clear()
+{
+	conjuncts.clear();
+	positions.clear();
+	conjunction = NodeRef();
+}
+
+Node*
+Session::normalForm()
+{
+	if (!conjunction) {
+		if (conjuncts.empty())
+			return Node::tt();
+
+		NodeList args(conjuncts.size());
+
+		for (size_t i = 0; i < args.size(); ++i)
+			args[i] = conjuncts[i].normal.get();
+
+		conjunction = NodeRef(Node::And(move(args)));
+	}
+
+	return conjunction.get();
+}
+
+Node*
+Session::normalForm(const string& name) const
+{
+	auto it = positions.find(name);
+
+	return it != positions.end() ? conjuncts[it->second].normal.get() : nullptr;
+}
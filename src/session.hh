@@ -0,0 +1,82 @@
+/**
+ * @file session.hh
+ *
+ * Specification held as a conjunction of named formulae, which is kept
+ * normalized while its conjuncts are added, replaced and removed.
+ *
+ * The normal form of a conjunction is the conjunction of the normal forms
+ * of its conjuncts, so each edit only normalizes the formula it introduces,
+ * and the normal form of the specification is rebuilt from those of the
+ * conjuncts, which are kept. Sessions must not be used by several threads
+ * at the same time.
+ */
+
+#ifndef SESSION_HH
+#define SESSION_HH
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tree.hh"
+
+class Session
+{
+	public:
+	using Normalizer = std::function<Node*(Node*)>;
+
+	/**
+	 * Create an empty session (whose specification is true).
+	 *
+	 * @param normalizer Function normalizing the conjuncts.
+	 */
+	explicit Session(Normalizer normalizer);
+
+	/**
+	 * Add a conjunct or replace the conjunct with the same name (which
+	 * keeps its position).
+	 */
+	void set(const std::string& name, Node* formula);
+
+	/**
+	 * Remove a conjunct.
+	 *
+	 * @return Whether there was a conjunct with that name.
+	 */
+	bool remove(const std::string& name);
+
+	/**
+	 * Remove all conjuncts.
+	 */
+	void clear();
+
+	/**
+	 * Normal form of the specification (kept until the next edit).
+	 */
+	Node* normalForm();
+
+	/**
+	 * Normal form of a conjunct or null if there is none with that name.
+	 */
+	Node* normalForm(const std::string& name) const;
+
+	size_t size() const { return conjuncts.size(); }
+
+	private:
+	struct Conjunct
+	{
+		std::string name;
+		NodeRef normal;
+	};
+
+	Normalizer normalizer;
+
+	// Conjuncts in the order they were added, with their positions by name
+	std::vector<Conjunct> conjuncts;
+	std::unordered_map<std::string, size_t> positions;
+
+	NodeRef conjunction; // Normal form of the specification (if known)
+};
+
+#endif // SESSION_HH
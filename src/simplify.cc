@@ -0,0 +1,343 @@
+/**
+ * @file simplify.cc
+ *
+ * Simplification of formulae before their normalization.
+ */
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "simplify.hh"
+
+using namespace std;
+using Op = Node::Op;
+
+// Bound on the recursive calls of each check of implication
+constexpr int IMPLICATION_BUDGET = 16;
+// Conjunctions and disjunctions with more operands are not checked for
+// subsumption, since all pairs of operands are compared
+constexpr size_t MAX_SUBSUMPTION_OPERANDS = 64;
+
+/**
+ * Whether a formula only depends on the suffixes of words, so that it
+ * holds at some position if and only if it holds at every position.
+ */
+bool
+isSuffixInvariant(const Node* node)
+{
+	switch (node->type) {
+		case Op::TT:
+		case Op::FF:
+		case Op::GF:
+		case Op::FG:
+			return true;
+		case Op::AND:
+		case Op::OR:
+			return all_of(node->children.begin(), node->children.end(), isSuffixInvariant);
+		default:
+			return false;
+	}
+}
+
+/**
+ * Argument of a G or F operator (written with W, R, U or M).
+ */
+inline const Node*
+temporalArg(const Node* node)
+{
+	if (node->isG())
+		return is(node, Op::W) ? node->children[0] : node->children[1];
+
+	return is(node, Op::U) ? node->children[1] : node->children[0];
+}
+
+/**
+ * Syntactic check of implication (sound but incomplete), which gives up
+ * when the budget of recursive calls is exhausted.
+ */
+bool
+implies(const Node* f, const Node* g, int& budget)
+{
+	if (f == g || is(g, Op::TT) || is(f, Op::FF))
+		return true;
+
+	if (--budget < 0)
+		return false;
+
+	const auto impliesG = [&](const Node* child) { return implies(child, g, budget); };
+	const auto fImplies = [&](const Node* child) { return implies(f, child, budget); };
+
+	// Disjunctions on the left and conjunctions on the right are split first
+	if (is(f, Op::OR))
+		return all_of(f->children.begin(), f->children.end(), impliesG);
+
+	if (is(g, Op::AND))
+		return all_of(g->children.begin(), g->children.end(), fImplies);
+
+	if (is(g, Op::OR) && any_of(g->children.begin(), g->children.end(), fImplies))
+		return true;
+
+	if (is(f, Op::AND) && any_of(f->children.begin(), f->children.end(), impliesG))
+		return true;
+
+	if (((f->isG() && g->isG()) || (f->isF() && g->isF())) &&
+	    implies(temporalArg(f), temporalArg(g), budget))
+		return true;
+
+	const bool sameArity = f->children.size() == g->children.size();
+	const auto argsImply = [&] {
+		return sameArity && implies(f->children[0], g->children[0], budget) &&
+		       (f->children.size() == 1 || implies(f->children[1], g->children[1], budget));
+	};
+
+	switch (g->type) {
+		case Op::U:
+			if (implies(f, g->children[1], budget) || (is(f, Op::U) && argsImply()))
+				return true;
+			break;
+
+		case Op::W:
+			if (implies(f, g->children[1], budget) ||
+			    ((is(f, Op::U) || is(f, Op::W)) && argsImply()))
+				return true;
+			break;
+
+		case Op::R:
+		case Op::M:
+			if ((implies(f, g->children[0], budget) && implies(f, g->children[1], budget)) ||
+			    ((is(f, g->type) || is(f, Op::M)) && argsImply()))
+				return true;
+			break;
+
+		case Op::X:
+		case Op::FG:
+			return is(f, g->type) && argsImply();
+
+		case Op::GF:
+			return (is(f, Op::GF) || is(f, Op::FG)) && implies(f->children[0], g->children[0], budget);
+
+		default:
+			break;
+	}
+
+	// Either argument of U and W holds at the first position, and the right
+	// argument of R and M does
+	switch (f->type) {
+		case Op::U:
+		case Op::W:
+			return implies(f->children[0], g, budget) && implies(f->children[1], g, budget);
+		case Op::R:
+		case Op::M:
+			return implies(f->children[1], g, budget);
+		default:
+			return false;
+	}
+}
+
+inline bool
+implies(const Node* f, const Node* g)
+{
+	int budget = IMPLICATION_BUDGET;
+	return implies(f, g, budget);
+}
+
+/**
+ * Rebuild of a formula, where every node is built once for each different
+ * structure (so that equal subformulae are the same node), except its
+ * subformulae in normal form, which are kept. The nodes are kept alive by
+ * the table until the end.
+ */
+struct Simplifier
+{
+	unordered_map<const Node*, Node*> rebuilt; // Nodes of the input formula
+	unordered_map<string, Node*> built;        // Built nodes by structure
+	vector<Node*> table;
+
+	Node* simplify(const Node* node);
+	Node* build(Op type, NodeList&& args);
+	Node* combine(Op type, NodeList&& args);
+	Node* keep(Node* node);
+};
+
+Node*
+Simplifier::keep(Node* node)
+{
+	if (node->isUnique())
+		return node;
+
+	// The children are already unique for their structure
+	string key(1, char(node->type));
+
+	for (const Node* child : node->children)
+		key.append(reinterpret_cast<const char*>(&child), sizeof(child));
+
+	auto [it, inserted] = built.emplace(move(key), node);
+
+	if (!inserted)
+		return it->second != node ? takePlace(it->second, node) : node;
+
+	node->addUser();
+	table.push_back(node);
+
+	return node;
+}
+
+Node*
+Simplifier::combine(Op type, NodeList&& args)
+{
+	const bool conjunction = type == Op::AND;
+	const Op merged = conjunction ? Op::FG : Op::GF;
+	vector<Node*> operands, nexts, suffix;
+
+	for (Node* arg : args) {
+		// Nested operators are flattened
+		const bool nested = is(arg, type);
+		auto begin = nested ? arg->children.begin() : &arg;
+		auto end = nested ? arg->children.end() : &arg + 1;
+
+		for (auto it = begin; it != end; ++it) {
+			Node* operand = *it;
+
+			if (find(operands.begin(), operands.end(), operand) != operands.end())
+				continue;
+
+			if (is(operand, Op::X))
+				nexts.push_back(operand->children[0]);
+			else if (is(operand, merged))
+				suffix.push_back(operand->children[0]);
+
+			operands.push_back(operand);
+		}
+	}
+
+	// X a & X b = X(a & b) and X a | X b = X(a | b)
+	if (nexts.size() > 1) {
+		operands.erase(remove_if(operands.begin(), operands.end(),
+		                         [](Node* operand) { return is(operand, Op::X); }),
+		               operands.end());
+		operands.push_back(build(Op::X, { combine(type, move(nexts)) }));
+	}
+
+	// FG a & FG b = FG(a & b) and GF a | GF b = GF(a | b)
+	if (suffix.size() > 1) {
+		operands.erase(remove_if(operands.begin(), operands.end(),
+		                         [merged](Node* operand) { return is(operand, merged); }),
+		               operands.end());
+		operands.push_back(build(merged, { combine(type, move(suffix)) }));
+	}
+
+	// Operands implied by others are removed from conjunctions, and those
+	// implying others from disjunctions
+	if (operands.size() <= MAX_SUBSUMPTION_OPERANDS) {
+		vector<bool> removed(operands.size());
+
+		for (size_t i = 0; i < operands.size(); ++i)
+			for (size_t j = 0; j < operands.size() && !removed[i]; ++j)
+				if (i != j && !removed[j])
+					removed[i] = conjunction ? implies(operands[j], operands[i])
+					                         : implies(operands[i], operands[j]);
+
+		size_t kept = 0;
+
+		for (size_t i = 0; i < operands.size(); ++i)
+			if (!removed[i])
+				operands[kept++] = operands[i];
+
+		operands.resize(kept);
+	}
+
+	if (operands.empty())
+		return conjunction ? Node::tt() : Node::ff();
+
+	return keep(Node::make(type, NodeList(move(operands))));
+}
+
+Node*
+Simplifier::build(Op type, NodeList&& args)
+{
+	switch (type) {
+		case Op::AND:
+		case Op::OR:
+			return combine(type, move(args));
+
+		case Op::X:
+			if (isSuffixInvariant(args[0]))
+				return args[0];
+			break;
+
+		// a U φ = φ, a R φ = φ and G φ = φ for suffix-invariant φ
+		case Op::U:
+		case Op::R:
+			if (isSuffixInvariant(args[1]))
+				return args[1];
+			break;
+
+		case Op::W:
+			if (is(args[1], Op::FF) && isSuffixInvariant(args[0]))
+				return args[0];
+			break;
+
+		case Op::GF:
+		case Op::FG: {
+			Node* arg = args[0];
+
+			if (isSuffixInvariant(arg))
+				return arg;
+
+			// G F G a = F G a and F G F a = G F a
+			if (type == Op::GF ? arg->isG() : arg->isF())
+				return build(type == Op::GF ? Op::FG : Op::GF,
+				             { const_cast<Node*>(temporalArg(arg)) });
+
+			// GF(a & φ) = GF a & φ and GF(a | φ) = GF a | φ for suffix-invariant φ
+			// (and the same for FG)
+			if (is(arg, Op::AND) || is(arg, Op::OR)) {
+				vector<Node*> outer, inner;
+
+				for (Node* child : arg->children)
+					(isSuffixInvariant(child) ? outer : inner).push_back(child);
+
+				if (!outer.empty()) {
+					outer.push_back(build(type, { combine(arg->type, move(inner)) }));
+					return combine(arg->type, move(outer));
+				}
+			}
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	return keep(Node::make(type, move(args)));
+}
+
+Node*
+Simplifier::simplify(const Node* node)
+{
+	// Normal formulae would only be simplified at a cost, since they are
+	// not rewritten by the normalization
+	if (node->isNormal())
+		return const_cast<Node*>(node);
+
+	auto it = rebuilt.find(node);
+
+	if (it != rebuilt.end())
+		return it->second;
+
+	NodeList args(node->children.size());
+
+	for (size_t i = 0; i < args.size(); ++i)
+		args[i] = simplify(node->children[i]);
+
+	return rebuilt[node] = build(node->type, move(args));
+}
+
+Node*
+simplify(const Node* formula)
+{
+	Simplifier simplifier;
+	return releaseTable(simplifier.table, simplifier.simplify(formula));
+}
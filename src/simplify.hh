@@ -0,0 +1,41 @@
+/**
+ * @file simplify.hh
+ *
+ * Simplification of formulae before their normalization.
+ *
+ * The cost of the normalization is exponential in the number of occurrences
+ * that trigger its rules (see estimate.hh), and formulae written by hand or
+ * generated from specifications often contain redundancies that are cheaper
+ * to remove before. The DAG is rebuilt bottom-up, merging equal subformulae
+ * and applying some equivalences that remove triggers or operators:
+ *
+ *  - operands of And and Or implied by (resp. implying) other operands are
+ *    removed, according to a bounded syntactic check of implication (so that
+ *    a | (a & b) becomes a and a U b | F b becomes F b),
+ *  - X a & X b and X a | X b become X(a & b) and X(a | b),
+ *  - GF a | GF b and FG a & FG b become GF(a | b) and FG(a & b),
+ *  - formulae φ that only depend on the suffixes of words (Boolean
+ *    combinations of GF and FG formulae) are taken out of GF, FG and other
+ *    temporal operators, as in GF(a & φ) = GF a & φ, a U φ = φ, G φ = φ,
+ *  - G F G a = F G a and F G F a = G F a,
+ *
+ * besides the simplifications already made by the constructors of nodes.
+ * Subformulae in normal form are left unchanged, since they do not trigger
+ * any rule.
+ */
+
+#ifndef SIMPLIFY_HH
+#define SIMPLIFY_HH
+
+#include "tree.hh"
+
+/**
+ * Simplify a formula.
+ *
+ * @return An equivalent formula (without users), which only shares with the
+ * given one its subformulae in normal form (that are never modified by the
+ * normalization), or the given formula itself if it is in normal form.
+ */
+Node* simplify(const Node* formula);
+
+#endif // SIMPLIFY_HH
@@ -0,0 +1,1081 @@
+/**
+ * @file spotnorm.cc
+ *
+ * Normalize LTL formulae directly on Spot's formulae.
+ */
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "spotnorm.hh"
+#include "stats.hh"
+#include "trace.hh"
+#include "tree.hh"
+
+using namespace std;
+using formula = spot::formula;
+using op = spot::op;
+using Op = Node::Op;
+
+using FormulaList = vector<formula>;
+
+//
+//	View of Spot formulae as nodes
+//
+
+/**
+ * Operator of the node corresponding to a formula.
+ */
+Op
+typeOf(const formula& form)
+{
+	switch (form.kind()) {
+		case op::tt:
+			return Op::TT;
+		case op::ff:
+			return Op::FF;
+		case op::And:
+			return Op::AND;
+		case op::Or:
+			return Op::OR;
+		case op::X:
+			return Op::X;
+		case op::U:
+			return Op::U;
+		case op::W:
+			return Op::W;
+		case op::R:
+			return Op::R;
+		case op::M:
+			return Op::M;
+		case op::F:
+			return form[0].kind() == op::G ? Op::FG : Op::U;
+		case op::G:
+			return form[0].kind() == op::F ? Op::GF : Op::W;
+		default:
+			// Atomic propositions, their negations and unsupported operators
+			return Op::APROP;
+	}
+}
+
+inline size_t
+arity(const formula& form)
+{
+	const int count = arity(typeOf(form));
+	return count < 0 ? form.size() : count;
+}
+
+/**
+ * Argument of the node corresponding to a formula (F a is tt U a, G a is
+ * a W ff, and the argument of GF a and FG a is a).
+ */
+formula
+arg(const formula& form, size_t index)
+{
+	switch (form.kind()) {
+		case op::F:
+			if (form[0].kind() == op::G)
+				return form[0][0];
+
+			return index == 0 ? formula::tt() : form[0];
+
+		case op::G:
+			if (form[0].kind() == op::F)
+				return form[0][0];
+
+			return index == 0 ? form[0] : formula::ff();
+
+		default:
+			return form[index];
+	}
+}
+
+FormulaList
+args(const formula& form)
+{
+	FormulaList list(arity(form));
+
+	for (size_t i = 0; i < list.size(); ++i)
+		list[i] = arg(form, i);
+
+	return list;
+}
+
+inline bool
+is(const formula& form, Op type)
+{
+	return typeOf(form) == type;
+}
+
+inline bool
+isConstant(const formula& form)
+{
+	return form.is_tt() || form.is_ff();
+}
+
+inline bool
+isGlobally(const formula& form)
+{
+	return (is(form, Op::W) && arg(form, 1).is_ff()) || (is(form, Op::R) && arg(form, 0).is_ff());
+}
+
+inline bool
+isEventually(const formula& form)
+{
+	return (is(form, Op::U) && arg(form, 0).is_tt()) || (is(form, Op::M) && arg(form, 1).is_tt());
+}
+
+//
+//	Constructors with the simplifications of those of nodes
+//
+
+formula makeAnd(FormulaList&& args);
+formula makeOr(FormulaList&& args);
+formula makeGF(const formula& arg);
+formula makeFG(const formula& arg);
+formula makeG(const formula& arg);
+formula makeF(const formula& arg);
+
+formula
+makeX(const formula& arg)
+{
+	if (isConstant(arg) || is(arg, Op::GF) || is(arg, Op::FG))
+		return arg;
+
+	return formula::X(arg);
+}
+
+formula
+makeU(const formula& left, const formula& right)
+{
+	if (left.is_ff() || left == right || isConstant(right) || isEventually(right))
+		return right;
+
+	if (left.is_tt()) { // F operator
+		if (is(right, Op::OR)) {
+			FormulaList list(right.begin(), right.end());
+			transform(list.begin(), list.end(), list.begin(), makeF);
+			return makeOr(move(list));
+		}
+
+		if (isGlobally(right))
+			return makeFG(is(right, Op::W) ? arg(right, 0) : arg(right, 1));
+
+		return formula::F(right);
+	}
+
+	return formula::U(left, right);
+}
+
+formula
+makeW(const formula& left, const formula& right)
+{
+	if (left.is_ff() || left == right)
+		return right;
+
+	if (right.is_tt() || left.is_tt())
+		return formula::tt();
+
+	if (isGlobally(left))
+		return makeOr({ left, right });
+
+	if (right.is_ff()) { // G operator
+		if (is(left, Op::AND)) {
+			FormulaList list(left.begin(), left.end());
+			transform(list.begin(), list.end(), list.begin(), makeG);
+			return makeAnd(move(list));
+		}
+
+		if (isEventually(left))
+			return makeGF(is(left, Op::U) ? arg(left, 1) : arg(left, 0));
+
+		return formula::G(left);
+	}
+
+	return formula::W(left, right);
+}
+
+formula
+makeR(const formula& left, const formula& right)
+{
+	if (left.is_tt() || left == right || isConstant(right) || isGlobally(right))
+		return right;
+
+	if (left.is_ff()) { // G operator
+		if (is(right, Op::AND)) {
+			FormulaList list(right.begin(), right.end());
+			transform(list.begin(), list.end(), list.begin(), makeG);
+			return makeAnd(move(list));
+		}
+
+		if (isEventually(right))
+			return makeGF(is(right, Op::U) ? arg(right, 1) : arg(right, 0));
+
+		return formula::G(right);
+	}
+
+	return formula::R(left, right);
+}
+
+formula
+makeM(const formula& left, const formula& right)
+{
+	if (left.is_tt() || left == right)
+		return right;
+
+	if (right.is_ff() || left.is_ff())
+		return formula::ff();
+
+	if (isEventually(left))
+		return makeAnd({ left, right });
+
+	if (right.is_tt()) { // F operator
+		if (is(left, Op::OR)) {
+			FormulaList list(left.begin(), left.end());
+			transform(list.begin(), list.end(), list.begin(), makeF);
+			return makeOr(move(list));
+		}
+
+		if (isGlobally(left))
+			return makeFG(is(left, Op::W) ? arg(left, 0) : arg(left, 1));
+
+		return formula::F(left);
+	}
+
+	return formula::M(left, right);
+}
+
+formula
+makeGF(const formula& form)
+{
+	if (isConstant(form))
+		return form;
+
+	if (is(form, Op::X))
+		return makeGF(form[0]);
+
+	if (isEventually(form))
+		return makeGF(is(form, Op::U) ? arg(form, 1) : arg(form, 0));
+
+	return formula::G(formula::F(form));
+}
+
+formula
+makeFG(const formula& form)
+{
+	if (isConstant(form))
+		return form;
+
+	if (is(form, Op::X))
+		return makeFG(form[0]);
+
+	if (isGlobally(form))
+		return makeFG(is(form, Op::W) ? arg(form, 0) : arg(form, 1));
+
+	return formula::F(formula::G(form));
+}
+
+formula
+makeG(const formula& arg)
+{
+	return makeW(arg, formula::ff());
+}
+
+formula
+makeF(const formula& arg)
+{
+	return makeU(formula::tt(), arg);
+}
+
+formula
+makeAnd(FormulaList&& args)
+{
+	if (any_of(args.begin(), args.end(), [](const formula& arg) { return arg.is_ff(); }))
+		return formula::ff();
+
+	// Spot also removes true, flattens, sorts and deduplicates the operands
+	return formula::And(move(args));
+}
+
+formula
+makeOr(FormulaList&& args)
+{
+	if (any_of(args.begin(), args.end(), [](const formula& arg) { return arg.is_tt(); }))
+		return formula::tt();
+
+	return formula::Or(move(args));
+}
+
+formula
+make(Op type, FormulaList&& args)
+{
+	switch (type) {
+		case Op::X:
+			return makeX(args[0]);
+
+		case Op::AND:
+			return makeAnd(move(args));
+
+		case Op::OR:
+			return makeOr(move(args));
+
+		case Op::U:
+			return makeU(args[0], args[1]);
+
+		case Op::W:
+			return makeW(args[0], args[1]);
+
+		case Op::R:
+			return makeR(args[0], args[1]);
+
+		case Op::M:
+			return makeM(args[0], args[1]);
+
+		case Op::GF:
+			return makeGF(args[0]);
+
+		case Op::FG:
+			return makeFG(args[0]);
+
+		default:
+			return formula(); // Cannot happen
+	}
+}
+
+//
+//	Normalization (with the same steps and rules as normalizer.cc)
+//
+
+struct FindUFormula
+{
+	formula gfa;  // The argument of the rule's GF
+	formula ff;   // The formula where the U/M has been replaced by false
+	formula weak; // The formula where the U/M has been replaced by W/R
+};
+
+struct FindWFormula
+{
+	formula fga;    // The argument of the rule's FG
+	formula strong; // The formula where the W/R has been replaced by U/M
+	formula tt;     // The formula where the W/R has been replaced by true
+};
+
+/**
+ * Normalization of a formula, where the result of each step on each
+ * subformula is memoized on its identifier. The formulae are kept alive
+ * by the tables until the end, so their identifiers are not reused.
+ */
+struct SpotNormalizer
+{
+	unordered_map<formula, formula> rebuilt;
+	unordered_map<formula, uint8_t> classes;
+	unordered_map<formula, bool> hasU;
+	unordered_map<formula, formula> removedWU, removedGF, fixedGF, fixedGFW, fixedFGU;
+
+	formula rebuild(const formula& form);
+	uint8_t classify(const formula& form);
+	bool isNormal(const formula& form) { return classify(form) & Node::NORMAL; }
+
+	bool containsU(const formula& form);
+	formula removeWU(const formula& form);
+	formula removeGF(const formula& form);
+	formula fixGFW(const formula& form, const formula& existing = formula());
+	formula fixFGU(const formula& form, const formula& existing = formula());
+	formula fixGF(const formula& form);
+	formula normalize(const formula& input);
+};
+
+/**
+ * Rebuild a formula with the simplifications of the constructors of nodes,
+ * which are applied to the input of the other engine when converted.
+ */
+formula
+SpotNormalizer::rebuild(const formula& form)
+{
+	const Op type = typeOf(form);
+
+	if (arity(form) == 0)
+		return form;
+
+	auto it = rebuilt.find(form);
+
+	if (it != rebuilt.end())
+		return it->second;
+
+	FormulaList copy = args(form);
+
+	for (formula& child : copy)
+		child = rebuild(child);
+
+	return rebuilt[form] = make(type, move(copy));
+}
+
+uint8_t
+SpotNormalizer::classify(const formula& form)
+{
+	auto it = classes.find(form);
+
+	if (it != classes.end())
+		return it->second;
+
+	// Classes shared by all the arguments (as in Node::classify)
+	uint8_t common = Node::ALL_CLASSES, result;
+	const size_t count = arity(form);
+
+	for (size_t i = 0; i < count; ++i)
+		common &= classify(arg(form, i));
+
+	switch (typeOf(form)) {
+		case Op::AND:
+		case Op::OR:
+			result = common;
+			break;
+		case Op::X:
+			result = common & (Node::GUARANTEE | Node::SAFETY | Node::PERSISTENCE);
+			break;
+		case Op::U:
+		case Op::M:
+			result = common & (Node::GUARANTEE | Node::PERSISTENCE);
+			break;
+		case Op::W:
+		case Op::R:
+			result = (common & Node::SAFETY) ? Node::SAFETY | Node::PERSISTENCE : 0;
+			break;
+		case Op::GF:
+			result = (common & Node::GUARANTEE) ? Node::NORMAL : 0;
+			break;
+		case Op::FG:
+			result = (common & Node::SAFETY) ? Node::NORMAL : 0;
+			break;
+		default:
+			result = Node::ALL_CLASSES;
+	}
+
+	if (result & Node::PERSISTENCE)
+		result |= Node::NORMAL;
+
+	return classes[form] = result;
+}
+
+//
+//	Step 1: removing U/M below W/R
+//
+
+bool
+SpotNormalizer::containsU(const formula& form)
+{
+	switch (typeOf(form)) {
+		case Op::AND:
+		case Op::OR:
+		case Op::X:
+		case Op::W:
+		case Op::R: {
+			auto it = hasU.find(form);
+
+			if (it != hasU.end())
+				return it->second;
+
+			const size_t count = arity(form);
+			bool result = false;
+
+			for (size_t i = 0; i < count && !result; ++i)
+				result = containsU(arg(form, i));
+
+			return hasU[form] = result;
+		}
+		case Op::U:
+		case Op::M:
+			return true;
+		default:
+			return false;
+	}
+}
+
+pair<formula, formula>
+replaceU(const formula& form, const formula& gfa)
+{
+	const Op type = typeOf(form);
+
+	switch (type) {
+		case Op::AND:
+		case Op::OR:
+		case Op::X:
+		case Op::W:
+		case Op::R: {
+			bool changed = false;
+			// The copies are only made when the first argument changes
+			FormulaList ffCopy, weakCopy;
+			const size_t count = arity(form);
+
+			for (size_t i = 0; i < count; ++i) {
+				auto [ff, weak] = replaceU(arg(form, i), gfa);
+
+				if (ff) {
+					if (!changed)
+						ffCopy = weakCopy = args(form);
+
+					changed = true;
+					ffCopy[i] = ff;
+					weakCopy[i] = weak;
+				}
+			}
+
+			if (changed)
+				return { make(type, move(ffCopy)), make(type, move(weakCopy)) };
+
+			return {};
+		}
+		case Op::U:
+			if (gfa == arg(form, 1))
+				return { formula::ff(), makeW(arg(form, 0), gfa) };
+
+			return {};
+
+		case Op::M:
+			if (gfa == arg(form, 0))
+				return { formula::ff(), makeR(gfa, arg(form, 1)) };
+
+			return {};
+
+		default:
+			return {};
+	}
+}
+
+bool
+findU(const formula& form, FindUFormula& result)
+{
+	const Op type = typeOf(form);
+
+	switch (type) {
+		case Op::AND:
+		case Op::OR:
+		case Op::X:
+		case Op::W:
+		case Op::R: {
+			const size_t count = arity(form);
+
+			for (size_t i = 0; i < count; ++i)
+				if (findU(arg(form, i), result)) {
+					// Rebuild the formula with the two variants of U/M operator in the rule
+					FormulaList ffCopy = args(form);
+					FormulaList weakCopy = ffCopy;
+					ffCopy[i] = result.ff;
+					weakCopy[i] = result.weak;
+
+					for (size_t j = i + 1; j < count; ++j) {
+						auto [ff, weak] = replaceU(ffCopy[j], result.gfa);
+
+						if (ff) {
+							ffCopy[j] = ff;
+							weakCopy[j] = weak;
+						}
+					}
+
+					result.ff = make(type, move(ffCopy));
+					result.weak = make(type, move(weakCopy));
+					return true;
+				}
+			return false;
+		}
+		case Op::U:
+			result.gfa = arg(form, 1);
+			result.ff = formula::ff();
+			result.weak = makeW(arg(form, 0), arg(form, 1));
+			return true;
+
+		case Op::M:
+			result.gfa = arg(form, 0);
+			result.ff = formula::ff();
+			result.weak = makeR(arg(form, 0), arg(form, 1));
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+formula
+SpotNormalizer::removeWU(const formula& form)
+{
+	// Normal formulae do not contain U/M below W/R (except inside GF/FG)
+	if (isNormal(form))
+		return form;
+
+	auto it = removedWU.find(form);
+
+	if (it != removedWU.end())
+		return it->second;
+
+	const Op type = typeOf(form);
+	formula result = form;
+
+	switch (type) {
+		case Op::AND:
+		case Op::OR:
+		case Op::X:
+		case Op::U:
+		case Op::M: {
+			FormulaList copy = args(form);
+			bool changed = false;
+
+			for (formula& child : copy) {
+				formula newChild = removeWU(child);
+				changed |= newChild != child;
+				child = move(newChild);
+			}
+
+			if (changed)
+				result = make(type, move(copy));
+			break;
+		}
+		case Op::W: {
+			const formula left = arg(form, 0), right = arg(form, 1);
+			FindUFormula found;
+
+			// (1) a W f[b U/M c] = a U f[b U/M c] | G a
+			if (containsU(right)) {
+				countRule(1);
+				TraceSpan span("rule 1");
+
+				result = makeOr({ makeU(removeWU(left), removeWU(right)), removeWU(makeG(left)) });
+			}
+			// (2) f[a U b] W c = (GF b & f[a W b] W c) | f[a U b] U (c | G f[ff])
+			// (2) f[a M b] W c = (GF a & f[a R b] W c) | f[a M b] U (c | G f[ff])
+			else if (findU(left, found)) {
+				countRule(2);
+				TraceSpan span("rule 2");
+
+				formula andForm = makeAnd({ makeGF(found.gfa), removeWU(makeW(found.weak, right)) });
+				formula urForm = makeOr({ right, removeWU(makeG(found.ff)) });
+				result = makeOr({ andForm, makeU(removeWU(left), urForm) });
+			}
+			break;
+		}
+		case Op::R: {
+			const formula left = arg(form, 0), right = arg(form, 1);
+			FindUFormula found;
+
+			// (1) f[a U/M b] R c = f[a U/M b] M c | G c
+			if (containsU(left)) {
+				countRule(1);
+				TraceSpan span("rule 1");
+
+				result = makeOr({ makeM(removeWU(left), removeWU(right)), removeWU(makeG(right)) });
+			}
+			// (2) a R f[a U b] = (GF b & a R f[a U b]) | (a | G f[ff]) M f[a U b]
+			// (2) a R f[a M b] = (GF a & a R f[a R b]) | (a | G f[ff]) M f[a M b]
+			else if (findU(right, found)) {
+				countRule(2);
+				TraceSpan span("rule 2");
+
+				formula andForm = makeAnd({ makeGF(found.gfa), removeWU(makeR(left, found.weak)) });
+				formula mlForm = makeOr({ left, removeWU(makeG(found.ff)) });
+				result = makeOr({ andForm, makeM(mlForm, removeWU(right)) });
+			}
+			break;
+		}
+		default:
+			break;
+	}
+
+	return removedWU[form] = result;
+}
+
+//
+//	Step 2: remove GF
+//
+
+formula
+findGF(const formula& form, bool proper = false)
+{
+	const Op type = typeOf(form);
+
+	switch (type) {
+		case Op::AND:
+		case Op::OR:
+		case Op::U:
+		case Op::X:
+		case Op::W:
+		case Op::R:
+		case Op::M: {
+			const size_t count = arity(form);
+
+			for (size_t i = 0; i < count; ++i)
+				if (formula childGF =
+				      findGF(arg(form, i), proper || (type != Op::AND && type != Op::OR)))
+					return childGF;
+
+			return formula();
+		}
+		case Op::GF:
+		case Op::FG: {
+			// Only GF-formulae below a temporal operator are considered, and
+			// the innermost is prefered in case there are nested ones
+			formula childGF = findGF(arg(form, 0), true);
+			return childGF ? childGF : (proper ? form : formula());
+		}
+		default:
+			return formula();
+	}
+}
+
+/**
+ * Replace a GF or FG formula by another, visiting each subformula once.
+ */
+formula
+replace(const formula& form, const formula& left, const formula& right,
+        unordered_map<formula, formula>& replaced)
+{
+	if (form == left)
+		return right;
+
+	const Op type = typeOf(form);
+
+	if (arity(form) == 0)
+		return form;
+
+	auto it = replaced.find(form);
+
+	if (it != replaced.end())
+		return it->second;
+
+	FormulaList copy = args(form);
+	bool changed = false;
+
+	for (formula& child : copy) {
+		formula newChild = replace(child, left, right, replaced);
+		changed |= newChild != child;
+		child = move(newChild);
+	}
+
+	return replaced[form] = changed ? make(type, move(copy)) : form;
+}
+
+formula
+SpotNormalizer::removeGF(const formula& form)
+{
+	// Normal formulae do not contain GF/FG below temporal operators
+	if (isNormal(form))
+		return form;
+
+	auto it = removedGF.find(form);
+
+	if (it != removedGF.end())
+		return it->second;
+
+	formula result = form;
+
+	// Removing GF separately on each topmost temporal formula reduces
+	// in some cases (and increase in some others) the output size
+	if (is(form, Op::AND) || is(form, Op::OR)) {
+		FormulaList copy = args(form);
+
+		for (formula& child : copy)
+			child = removeGF(child);
+
+		result = make(typeOf(form), move(copy));
+	}
+	// (3) f[GF a] = (GF a & f[tt]) | f[ff]
+	// (3) f[FG a] = (FG a & f[tt]) | f[ff]
+	else if (formula found = findGF(form)) {
+		countRule(3);
+		TraceSpan span("rule 3");
+
+		unordered_map<formula, formula> replaced;
+		formula ttVariant = replace(form, found, formula::tt(), replaced);
+		replaced.clear();
+		formula ffVariant = replace(form, found, formula::ff(), replaced);
+
+		// The cofactors are shared through the memoization, and the split is
+		// useless when both give the same formula, since (GF a & f) | f = f
+		const formula high = removeGF(ttVariant), low = removeGF(ffVariant);
+		result = high == low ? high : makeOr({ makeAnd({ found, high }), low });
+	}
+
+	return removedGF[form] = result;
+}
+
+//
+//	Step 3: remove W/R inside GF
+//
+
+pair<formula, formula>
+replaceW(const formula& form, const formula& fga)
+{
+	const Op type = typeOf(form);
+
+	switch (type) {
+		case Op::AND:
+		case Op::OR:
+		case Op::X:
+		case Op::U:
+		case Op::M: {
+			bool changed = false;
+			// The copies are only made when the first argument changes
+			FormulaList ttCopy, strongCopy;
+			const size_t count = arity(form);
+
+			for (size_t i = 0; i < count; ++i) {
+				auto [tt, strong] = replaceW(arg(form, i), fga);
+
+				if (tt) {
+					if (!changed)
+						ttCopy = strongCopy = args(form);
+
+					changed = true;
+					ttCopy[i] = tt;
+					strongCopy[i] = strong;
+				}
+			}
+
+			if (changed)
+				return { make(type, move(ttCopy)), make(type, move(strongCopy)) };
+
+			return {};
+		}
+		case Op::W:
+			if (fga == arg(form, 0))
+				return { formula::tt(), makeU(fga, arg(form, 1)) };
+
+			return {};
+
+		case Op::R:
+			if (fga == arg(form, 1))
+				return { formula::tt(), makeM(arg(form, 0), fga) };
+
+			return {};
+
+		default:
+			return {};
+	}
+}
+
+bool
+findW(const formula& form, FindWFormula& result)
+{
+	const Op type = typeOf(form);
+
+	switch (type) {
+		case Op::AND:
+		case Op::OR:
+		case Op::X:
+		case Op::U:
+		case Op::M: {
+			const size_t count = arity(form);
+
+			for (size_t i = 0; i < count; ++i)
+				if (findW(arg(form, i), result)) {
+					// Rebuild the formula with the variants of W/R operator in the rule
+					FormulaList strongCopy = args(form);
+					FormulaList ttCopy = strongCopy;
+					strongCopy[i] = result.strong;
+					ttCopy[i] = result.tt;
+
+					for (size_t j = i + 1; j < count; ++j) {
+						auto [tt, strong] = replaceW(ttCopy[j], result.fga);
+
+						if (tt) {
+							ttCopy[j] = tt;
+							strongCopy[j] = strong;
+						}
+					}
+
+					result.strong = make(type, move(strongCopy));
+					result.tt = make(type, move(ttCopy));
+					return true;
+				}
+			return false;
+		}
+		case Op::W:
+			result.fga = arg(form, 0);
+			result.strong = makeU(arg(form, 0), arg(form, 1));
+			result.tt = formula::tt();
+			return true;
+
+		case Op::R:
+			result.fga = arg(form, 1);
+			result.strong = makeM(arg(form, 0), arg(form, 1));
+			result.tt = formula::tt();
+			return true;
+
+		case Op::GF:
+		case Op::FG:
+			result.fga = arg(form, 0);
+			result.strong = formula::ff();
+			result.tt = formula::tt();
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+formula
+SpotNormalizer::fixGFW(const formula& form, const formula& existing)
+{
+	auto it = fixedGFW.find(form);
+
+	if (it != fixedGFW.end())
+		return it->second;
+
+	FindWFormula found;
+	formula result;
+
+	// (4) GF f[a W b] = GF f[a U b] | (FG a & GF f[tt])
+	// (4) GF f[a R b] = GF f[a M b] | (FG b & GF f[tt])
+	if (findW(form, found)) {
+		countRule(4);
+		TraceSpan span("rule 4");
+
+		formula andForm = makeAnd({ fixFGU(found.fga), fixGFW(found.tt) });
+		result = makeOr({ fixGFW(found.strong), andForm });
+	}
+	// 'existing' is the original GF-formula to be fixed ('form' is its
+	// argument), which is returned as is for an unchanged formula
+	else
+		result = existing ? existing : makeGF(form);
+
+	return fixedGFW[form] = result;
+}
+
+formula
+SpotNormalizer::fixFGU(const formula& form, const formula& existing)
+{
+	auto it = fixedFGU.find(form);
+
+	if (it != fixedFGU.end())
+		return it->second;
+
+	FindUFormula found;
+	formula result;
+
+	// (5) FG f[a U b] = (GF b & FG f[a W b]) | FG f[ff]
+	// (5) FG f[a M b] = (GF a & FG f[a R b]) | FG f[ff]
+	if (findU(form, found)) {
+		countRule(5);
+		TraceSpan span("rule 5");
+
+		formula andForm = makeAnd({ fixGFW(found.gfa), fixFGU(found.weak) });
+		result = makeOr({ andForm, fixFGU(found.ff) });
+	} else
+		result = existing ? existing : makeFG(form);
+
+	return fixedFGU[form] = result;
+}
+
+formula
+SpotNormalizer::fixGF(const formula& form)
+{
+	// Normal formulae do not contain W/R inside GF nor U/M inside FG
+	if (isNormal(form))
+		return form;
+
+	switch (typeOf(form)) {
+		case Op::AND:
+		case Op::OR: {
+			auto it = fixedGF.find(form);
+
+			if (it != fixedGF.end())
+				return it->second;
+
+			FormulaList copy = args(form);
+
+			for (formula& child : copy)
+				child = fixGF(child);
+
+			return fixedGF[form] = make(typeOf(form), move(copy));
+		}
+		case Op::GF:
+			return fixGFW(arg(form, 0), form);
+
+		case Op::FG:
+			return fixFGU(arg(form, 0), form);
+
+		default:
+			return form;
+	}
+}
+
+formula
+SpotNormalizer::normalize(const formula& input)
+{
+	const formula form = rebuild(input);
+
+	// Formulae already in normal form are left untouched by every step
+	if (isNormal(form))
+		return form;
+
+	formula result;
+	{
+		PhaseTimer timer(FormulaStats::REMOVE_WU);
+		TraceSpan span("removeWU");
+		result = removeWU(form);
+	}
+	{
+		PhaseTimer timer(FormulaStats::REMOVE_GF);
+		TraceSpan span("removeGF");
+		result = removeGF(result);
+	}
+
+	PhaseTimer timer(FormulaStats::FIX_GF);
+	TraceSpan span("fixGF");
+	return fixGF(result);
+}
+
+formula
+normalizeSpot(const formula& form)
+{
+	SpotNormalizer normalizer;
+	return normalizer.normalize(form);
+}
+
+//
+//	Size of the formulae
+//
+
+size_t
+treeSize(const formula& form, unordered_map<formula, size_t>& sizes)
+{
+	if (isConstant(form))
+		return 0;
+
+	auto it = sizes.find(form);
+
+	if (it != sizes.end())
+		return it->second;
+
+	size_t size = 1;
+
+	for (const formula& child : form)
+		size += treeSize(child, sizes);
+
+	return sizes[form] = size;
+}
+
+size_t
+treeSize(const formula& form)
+{
+	unordered_map<formula, size_t> sizes;
+	return treeSize(form, sizes);
+}
+
+size_t
+dagSize(const formula& form)
+{
+	unordered_set<formula> seen{ form };
+	vector<formula> pending{ form };
+
+	while (!pending.empty()) {
+		formula next = pending.back();
+		pending.pop_back();
+
+		for (const formula& child : next)
+			if (seen.insert(child).second)
+				pending.push_back(child);
+	}
+
+	return seen.size() - seen.count(formula::tt()) - seen.count(formula::ff());
+}
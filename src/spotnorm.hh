@@ -0,0 +1,42 @@
+/**
+ * @file spotnorm.hh
+ *
+ * Normalize LTL formulae directly on Spot's formulae.
+ *
+ * This engine applies the same rules as normalizer.hh, but rewrites Spot's
+ * hash-consed formulae instead of nodes, so that the formulae of a tool based
+ * on Spot are normalized without converting them back and forth. Since equal
+ * subformulae are the same formula, the result of each pass on a subformula
+ * is memoized on its identifier and computed only once per formula. The
+ * formulae are seen as nodes (with F and G as U and W, and GF and FG as single
+ * operators) and rebuilt with the same simplifications as the constructors of
+ * nodes, but Spot also sorts and deduplicates the operands of And and Or, so
+ * normal forms may differ from those of nodes while still being equivalent.
+ *
+ * Spot is not thread-safe, so these functions must not be called while Spot
+ * formulae are used concurrently by other threads.
+ */
+
+#ifndef SPOTNORM_HH
+#define SPOTNORM_HH
+
+#include <spot/tl/formula.hh>
+
+/**
+ * Normalize a formula in negation normal form.
+ *
+ * Operators other than those of LTL are seen as atomic propositions.
+ */
+spot::formula normalizeSpot(const spot::formula& formula);
+
+/**
+ * Number of nodes of the formula when written as a tree (constants excluded).
+ */
+size_t treeSize(const spot::formula& formula);
+
+/**
+ * Number of distinct subformulae of the formula (constants excluded).
+ */
+size_t dagSize(const spot::formula& formula);
+
+#endif // SPOTNORM_HH
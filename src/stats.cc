@@ -0,0 +1,180 @@
+/**
+ * @file stats.cc
+ *
+ * Instrumentation of the normalization of each formula.
+ */
+
+#include "dagio.hh"
+#include "stats.hh"
+
+using namespace std;
+
+thread_local FormulaStats* FormulaStats::current = nullptr;
+
+const char*
+FormulaStats::phaseName(Phase phase)
+{
+	switch (phase) {
+		case FROM_SPOT:
+			return "from_spot";
+		case SIMPLIFY:
+			return "simplify";
+		case REMOVE_WU:
+			return "removeWU";
+		case REMOVE_GF:
+			return "removeGF";
+		case FIX_GF:
+			return "fixGF";
+		case TO_SPOT:
+			return "to_spot";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * Memory used by a node (with its array of children).
+ */
+inline size_t
+nodeBytes(const Node* node)
+{
+	return sizeof(Node) + node->children.heapBytes();
+}
+
+void
+FormulaStats::countNode(const Node* node, bool allocated)
+{
+	const int64_t size = nodeBytes(node);
+
+	if (allocated) {
+		this->allocated++;
+		bytesByOp[size_t(node->type)] += size;
+
+		if (++live > peakLive)
+			peakLive = live;
+
+		if ((bytes += size) > peakBytes)
+			peakBytes = bytes;
+
+		if (alive)
+			alive->insert(node);
+	} else {
+		live--;
+		bytes -= size;
+
+		// Nodes allocated before the statistics were installed
+		// are not in the set
+		if (alive)
+			alive->erase(node);
+	}
+}
+
+/**
+ * Write a string as a JSON or CSV quoted string.
+ */
+void
+printQuoted(ostream& out, const string& text, bool json)
+{
+	out << '"';
+
+	for (char c : text) {
+		if (c == '"')
+			out << (json ? "\\\"" : "\"\"");
+		else if (json && c == '\\')
+			out << "\\\\";
+		else if (json && (unsigned char) c < 0x20)
+			out << "\\u00" << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 0xf];
+		else
+			out << c;
+	}
+
+	out << '"';
+}
+
+void
+printStatsHeader(ostream& out)
+{
+	out << "formula";
+
+	for (int i = 0; i < FormulaStats::NR_PHASES; ++i)
+		out << ",time_" << FormulaStats::phaseName(FormulaStats::Phase(i));
+
+	for (int i = 1; i <= FormulaStats::NR_RULES; ++i)
+		out << ",rule" << i;
+
+	out << ",allocated,peak_live,peak_bytes,init_size,init_dagsize,fin_size,fin_dagsize\n";
+}
+
+void
+printStats(ostream& out, StatsFormat format, const string& formula, const FormulaStats& stats)
+{
+	if (format == StatsFormat::CSV) {
+		printQuoted(out, formula, false);
+
+		for (uint64_t time : stats.phaseTime)
+			out << ',' << time;
+
+		for (uint64_t count : stats.ruleCount)
+			out << ',' << count;
+
+		out << ',' << stats.allocated << ',' << stats.peakLive << ',' << stats.peakBytes << ','
+		    << stats.inTree << ',' << stats.inDag << ',' << stats.outTree << ',' << stats.outDag << '\n';
+	} else if (format == StatsFormat::JSON) {
+		out << "{\"formula\": ";
+		printQuoted(out, formula, true);
+		out << ", \"time\": {";
+
+		for (int i = 0; i < FormulaStats::NR_PHASES; ++i)
+			out << (i ? ", \"" : "\"") << FormulaStats::phaseName(FormulaStats::Phase(i))
+			    << "\": " << stats.phaseTime[i];
+
+		out << "}, \"rules\": [";
+
+		for (int i = 0; i < FormulaStats::NR_RULES; ++i)
+			out << (i ? ", " : "") << stats.ruleCount[i];
+
+		out << "], \"allocated\": " << stats.allocated << ", \"peak_live\": " << stats.peakLive
+		    << ", \"peak_bytes\": " << stats.peakBytes << ", \"bytes_by_op\": {";
+
+		bool first = true;
+
+		for (int i = 0; i < FormulaStats::NR_OPS; ++i)
+			if (stats.bytesByOp[i] > 0) {
+				out << (first ? "\"" : ", \"") << opName(Node::Op(i))
+				    << "\": " << stats.bytesByOp[i];
+				first = false;
+			}
+
+		out << "}"
+		    << ", \"init_size\": " << stats.inTree << ", \"init_dagsize\": " << stats.inDag
+		    << ", \"fin_size\": " << stats.outTree << ", \"fin_dagsize\": " << stats.outDag
+		    << "}\n";
+	}
+}
+
+bool
+reportMemory(ostream& out, const string& formula, const FormulaStats& stats)
+{
+	out << "Memory: " << stats.allocated << " nodes allocated, peak " << stats.peakLive
+	    << " nodes and " << stats.peakBytes << " bytes";
+
+	for (int i = 0; i < FormulaStats::NR_OPS; ++i)
+		if (stats.bytesByOp[i] > 0)
+			out << ", " << opName(Node::Op(i)) << " " << stats.bytesByOp[i];
+
+	out << "\n";
+
+	if (!stats.alive || stats.alive->empty())
+		return true;
+
+	out << "Error: " << stats.alive->size() << " nodes still alive after " << formula << "\n";
+
+	for (const Node* node : *stats.alive) {
+		out << "  " << node << " " << opName(node->type) << " with " << node->refCount
+		    << " users: ";
+		printDag(out, node);
+		out << "\n";
+	}
+
+	return false;
+}
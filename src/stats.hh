@@ -0,0 +1,211 @@
+/**
+ * @file stats.hh
+ *
+ * Instrumentation of the normalization of each formula.
+ *
+ * Statistics are collected by the thread that normalizes a formula while
+ * a FormulaStats object is installed as the current one with a StatsScope.
+ * Otherwise, the instrumentation points only check a null pointer.
+ *
+ * Memory is accounted for the nodes allocated and released by the thread,
+ * excluding the unique nodes (true, false and atomic propositions). When
+ * leak checking is enabled, the live nodes are also recorded, so that those
+ * still alive after a formula has been processed can be reported.
+ */
+
+#ifndef STATS_HH
+#define STATS_HH
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+
+#include "probes.hh"
+#include "tree.hh"
+
+struct FormulaStats
+{
+	enum Phase
+	{
+		FROM_SPOT,
+		SIMPLIFY,
+		REMOVE_WU,
+		REMOVE_GF,
+		FIX_GF,
+		TO_SPOT,
+		NR_PHASES
+	};
+
+	// Number of rules of the normalizer (numbered as in normalizer.cc: 1 and 2
+	// in removeWU, 3 for both case splits of removeGF, 4 and 5 in fixGF)
+	static constexpr int NR_RULES = 5;
+	static constexpr int NR_OPS = int(Node::Op::FG) + 1;
+
+	uint64_t phaseTime[NR_PHASES] = {}; // Nanoseconds spent in each phase
+	uint64_t ruleCount[NR_RULES] = {};  // Applications of each rule
+
+	uint64_t allocated = 0; // Nodes allocated (excluding the unique ones)
+	int64_t live = 0;       // Nodes allocated minus those released
+	int64_t peakLive = 0;   // Maximum of the above
+	int64_t bytes = 0;      // Memory of the nodes allocated minus those released
+	int64_t peakBytes = 0;  // Maximum of the above
+
+	uint64_t bytesByOp[NR_OPS] = {}; // Memory allocated for each operator
+
+	// Nodes alive (only if leaks are checked)
+	std::unordered_set<const Node*>* alive = nullptr;
+
+	// Sizes of the input and output formulae
+	size_t inTree = 0, inDag = 0;
+	size_t outTree = 0, outDag = 0;
+
+	static const char* phaseName(Phase phase);
+
+	/**
+	 * Count the allocation or release of a node.
+	 */
+	void countNode(const Node* node, bool allocated);
+
+	/**
+	 * Current statistics of this thread (or null if disabled).
+	 */
+	static thread_local FormulaStats* current;
+};
+
+/**
+ * Install statistics as the current ones during the lifetime of the object.
+ */
+struct StatsScope
+{
+	explicit StatsScope(FormulaStats* stats)
+	  : previous(FormulaStats::current)
+	{
+		FormulaStats::current = stats;
+	}
+
+	~StatsScope() { FormulaStats::current = previous; }
+
+	FormulaStats* previous;
+};
+
+/**
+ * Measure the time of a phase during the lifetime of the object (which is
+ * also reported to the pass probes).
+ */
+class PhaseTimer
+{
+	public:
+	explicit PhaseTimer(FormulaStats::Phase phase)
+	  : stats(FormulaStats::current)
+	  , phase(phase)
+	  , probed(LTLNORM_PROBE_ENABLED(pass__return))
+	{
+		LTLNORM_PROBE(pass__entry, int(phase), FormulaStats::phaseName(phase));
+
+		if (stats || probed)
+			start = std::chrono::steady_clock::now();
+	}
+
+	~PhaseTimer()
+	{
+		if (stats || probed) {
+			const auto elapsed = std::chrono::steady_clock::now() - start;
+			const uint64_t nanoseconds =
+			  std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+			if (stats)
+				stats->phaseTime[phase] += nanoseconds;
+
+			if (probed)
+				LTLNORM_PROBE(pass__return, int(phase), FormulaStats::phaseName(phase),
+				              nanoseconds);
+		}
+	}
+
+	private:
+	FormulaStats* stats;
+	FormulaStats::Phase phase;
+	bool probed;
+	std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * Report an application of a rule to the rule probes during the lifetime of
+ * the object.
+ */
+class RuleProbe
+{
+	public:
+	RuleProbe(int rule, [[maybe_unused]] const Node* node)
+	  : rule(rule)
+	  , timer(LTLNORM_PROBE_ENABLED(rule__return))
+	{
+		if (LTLNORM_PROBE_ENABLED(rule__entry))
+			LTLNORM_PROBE(rule__entry, rule, node, treeSize(node));
+	}
+
+	~RuleProbe() { LTLNORM_PROBE(rule__return, rule, timer.elapsed()); }
+
+	private:
+	int rule;
+	ProbeTimer timer;
+};
+
+/**
+ * Count an application of a rule of the normalizer.
+ */
+inline void
+countRule(int rule)
+{
+	if (FormulaStats* stats = FormulaStats::current)
+		stats->ruleCount[rule - 1]++;
+}
+
+/**
+ * Count the allocation or release of a node.
+ */
+inline void
+countNode(const Node* node, bool allocated)
+{
+	if (allocated)
+		LTLNORM_PROBE(node__alloc, node, int(node->type));
+	else
+		LTLNORM_PROBE(node__release, node, int(node->type));
+
+	if (FormulaStats* stats = FormulaStats::current)
+		stats->countNode(node, allocated);
+}
+
+//
+//	Output of the statistics (one line per formula)
+//
+
+enum class StatsFormat
+{
+	NONE,
+	JSON,
+	CSV
+};
+
+/**
+ * Print the header line of the CSV format.
+ */
+void printStatsHeader(std::ostream& out);
+
+/**
+ * Print the statistics of a formula in a single line.
+ */
+void printStats(std::ostream& out, StatsFormat format, const std::string& formula,
+                const FormulaStats& stats);
+
+/**
+ * Report the memory usage of a formula and the nodes still alive after it
+ * has been processed (if leaks are checked).
+ *
+ * @return Whether no node has leaked.
+ */
+bool reportMemory(std::ostream& out, const std::string& formula, const FormulaStats& stats);
+
+#endif // STATS_HH
@@ -5,20 +5,26 @@
  */
 
 #include <iostream>
+#include <unordered_map>
 
+#include "stats.hh"
 #include "tfspot.hh"
+#include "trace.hh"
 
 using namespace std;
 using formula = spot::formula;
 using op = spot::op;
 using Op = Node::Op;
 
+/**
+ * Build the Spot formula for a node given those of its children.
+ */
 formula
-to_spot(Node* tree)
+makeSpot(const Node* node, const formula* args)
 {
-	switch (tree->type) {
+	switch (node->type) {
 		case Op::APROP:
-			return formula::ap(tree->name);
+			return formula::ap(node->name);
 
 		case Op::TT:
 			return formula::tt();
@@ -26,49 +32,43 @@ to_spot(Node* tree)
 		case Op::FF:
 			return formula::ff();
 
-		case Op::AND: {
-			vector<spot::formula> args(tree->children.size());
-			for (size_t i = 0; i < args.size(); i++)
-				args[i] = to_spot(tree->children[i]);
-			return formula::And(move(args));
-		}
-		case Op::OR: {
-			vector<spot::formula> args(tree->children.size());
-			for (size_t i = 0; i < args.size(); i++)
-				args[i] = to_spot(tree->children[i]);
-			return formula::Or(move(args));
-		}
+		case Op::AND:
+			return formula::And(vector<formula>(args, args + node->children.size()));
+
+		case Op::OR:
+			return formula::Or(vector<formula>(args, args + node->children.size()));
+
 		case Op::X:
-			return formula::X(to_spot(tree->children[0]));
+			return formula::X(args[0]);
 
 		case Op::U:
-			if (is(tree->children[0], Op::TT))
-				return formula::F(to_spot(tree->children[1]));
+			if (is(node->children[0], Op::TT))
+				return formula::F(args[1]);
 			else
-				return formula::U(to_spot(tree->children[0]), to_spot(tree->children[1]));
+				return formula::U(args[0], args[1]);
 		case Op::W:
-			if (is(tree->children[1], Op::FF))
-				return formula::G(to_spot(tree->children[0]));
+			if (is(node->children[1], Op::FF))
+				return formula::G(args[0]);
 			else
-				return formula::W(to_spot(tree->children[0]), to_spot(tree->children[1]));
+				return formula::W(args[0], args[1]);
 
 		case Op::R:
-			if (is(tree->children[0], Op::FF))
-				return formula::G(to_spot(tree->children[1]));
+			if (is(node->children[0], Op::FF))
+				return formula::G(args[1]);
 			else
-				return formula::R(to_spot(tree->children[0]), to_spot(tree->children[1]));
+				return formula::R(args[0], args[1]);
 
 		case Op::M:
-			if (is(tree->children[0], Op::TT))
-				return formula::F(to_spot(tree->children[0]));
+			if (is(node->children[0], Op::TT))
+				return formula::F(args[0]);
 			else
-				return formula::M(to_spot(tree->children[0]), to_spot(tree->children[1]));
+				return formula::M(args[0], args[1]);
 
 		case Op::GF:
-			return formula::G(formula::F(to_spot(tree->children[0])));
+			return formula::G(formula::F(args[0]));
 
 		case Op::FG:
-			return formula::F(formula::G(to_spot(tree->children[0])));
+			return formula::F(formula::G(args[0]));
 
 		default:
 			// All cases are covered, but to remove warnings...
@@ -76,68 +76,161 @@ to_spot(Node* tree)
 	}
 }
 
+formula
+to_spot(Node* tree)
+{
+	PhaseTimer timer(FormulaStats::TO_SPOT);
+	TraceSpan span("to_spot");
+
+	// Shared nodes (with more than one user) are converted only once, and
+	// the DAG is traversed with an explicit stack since formulae may be
+	// deeply nested. The results of the children of the nodes in the
+	// stack are kept in order in another stack.
+	unordered_map<const Node*, formula> shared;
+	vector<pair<const Node*, bool>> stack{ { tree, false } };
+	vector<formula> results;
+
+	while (!stack.empty()) {
+		auto [node, expanded] = stack.back();
+		const bool isShared = node->refCount > 1 && !node->children.empty();
+
+		if (!expanded) {
+			if (isShared) {
+				auto it = shared.find(node);
+
+				if (it != shared.end()) {
+					results.push_back(it->second);
+					stack.pop_back();
+					continue;
+				}
+			}
+
+			stack.back().second = true;
+
+			for (auto it = node->children.rbegin(); it != node->children.rend(); ++it)
+				stack.emplace_back(*it, false);
+		} else {
+			const size_t first = results.size() - node->children.size();
+			formula result = makeSpot(node, results.data() + first);
+			results.resize(first);
+
+			if (isShared)
+				shared.emplace(node, result);
+
+			results.push_back(move(result));
+			stack.pop_back();
+		}
+	}
+
+	return results.back();
+}
+
+/**
+ * Convert a Spot formula into a syntax tree, where each distinct Spot
+ * subformula (identified by its unique identifier) is converted once.
+ */
 Node*
-from_spot(const formula& form)
+fromSpot(const formula& form, unordered_map<size_t, Node*>& built, vector<Node*>& table)
 {
+	auto it = built.find(form.id());
+
+	if (it != built.end())
+		return it->second;
+
+	auto convert = [&](const formula& arg) { return fromSpot(arg, built, table); };
+	Node* node;
+
 	switch (form.kind()) {
 		case op::ap:
-			return Node::ap(form.ap_name());
+			node = Node::ap(form.ap_name());
+			break;
 
 		case op::tt:
-			return Node::tt();
+			node = Node::tt();
+			break;
 
 		case op::ff:
-			return Node::ff();
+			node = Node::ff();
+			break;
 
 		case op::And: {
-			vector<Node*> args(form.size());
+			NodeList args(form.size());
 			for (size_t i = 0; i < args.size(); i++)
-				args[i] = from_spot(form[i]);
-			return Node::And(move(args));
+				args[i] = convert(form[i]);
+			node = Node::And(move(args));
+			break;
 		}
 		case op::Or: {
-			vector<Node*> args(form.size());
+			NodeList args(form.size());
 			for (size_t i = 0; i < args.size(); i++)
-				args[i] = from_spot(form[i]);
-			return Node::Or(move(args));
+				args[i] = convert(form[i]);
+			node = Node::Or(move(args));
+			break;
 		}
 		case op::X:
-			return Node::X(from_spot(form[0]));
+			node = Node::X(convert(form[0]));
+			break;
 
 		case op::U:
-			return Node::U(from_spot(form[0]), from_spot(form[1]));
+			node = Node::U(convert(form[0]), convert(form[1]));
+			break;
 
 		case op::W:
-			return Node::W(from_spot(form[0]), from_spot(form[1]));
+			node = Node::W(convert(form[0]), convert(form[1]));
+			break;
 
 		case op::F:
 			if (form[0].kind() == op::G)
-				return Node::FG(from_spot(form[0][0]));
+				node = Node::FG(convert(form[0][0]));
 			else
-				return Node::F(from_spot(form[0]));
+				node = Node::F(convert(form[0]));
+			break;
 
 		case op::G:
 			if (form[0].kind() == op::F)
-				return Node::GF(from_spot(form[0][0]));
+				node = Node::GF(convert(form[0][0]));
 			else
-				return Node::G(from_spot(form[0]));
+				node = Node::G(convert(form[0]));
+			break;
 
 		case op::R:
-			return Node::R(from_spot(form[0]), from_spot(form[1]));
+			node = Node::R(convert(form[0]), convert(form[1]));
+			break;
 
 		case op::M:
-			return Node::M(from_spot(form[0]), from_spot(form[1]));
+			node = Node::M(convert(form[0]), convert(form[1]));
+			break;
 
 		case op::Not:
 			if (form[0].kind() == op::ap)
-				return Node::ap("not" + form[0].ap_name());
+				node = Node::ap("not" + form[0].ap_name());
 			else {
 				cerr << "Warning: not in negation normal form. Seen as tt.\n";
-				return Node::tt();
+				node = Node::tt();
 			}
+			break;
+
 		default:
 			cerr << "Warning: unsupported operator " << form.kindstr()
 			     << ". Seen as tt.\n";
-			return Node::tt();
+			node = Node::tt();
+			break;
 	}
+
+	// Shared nodes are kept alive by the table until the formula is complete
+	node->addUser();
+	table.push_back(node);
+
+	return built[form.id()] = node;
+}
+
+Node*
+from_spot(const formula& form)
+{
+	PhaseTimer timer(FormulaStats::FROM_SPOT);
+	TraceSpan span("from_spot");
+	unordered_map<size_t, Node*> built;
+	vector<Node*> table;
+
+	return releaseTable(table, fromSpot(form, built, table));
 }
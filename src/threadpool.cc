@@ -0,0 +1,78 @@
+/**
+ * @file threadpool.cc
+ *
+ * Fixed pool of worker threads running queued tasks.
+ */
+
+#include <algorithm>
+
+#include "threadpool.hh"
+
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned nrThreads)
+{
+	if (nrThreads == 0)
+		nrThreads = max(thread::hardware_concurrency(), 1u);
+
+	threads.reserve(nrThreads);
+
+	for (unsigned i = 0; i < nrThreads; ++i)
+		threads.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	available.notify_all();
+
+	for (thread& worker : threads)
+		worker.join();
+}
+
+void
+ThreadPool::submit(function<void()>&& task)
+{
+	{
+		lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(move(task));
+	}
+
+	available.notify_one();
+}
+
+void
+ThreadPool::wait()
+{
+	unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this] { return tasks.empty() && running == 0; });
+}
+
+void
+ThreadPool::work()
+{
+	unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+		available.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+		// Pending tasks are completed before stopping
+		if (tasks.empty())
+			return;
+
+		function<void()> task = move(tasks.front());
+		tasks.pop_front();
+		running++;
+
+		lock.unlock();
+		task();
+		lock.lock();
+
+		if (--running == 0 && tasks.empty())
+			finished.notify_all();
+	}
+}
@@ -0,0 +1,58 @@
+/**
+ * @file threadpool.hh
+ *
+ * Fixed pool of worker threads running queued tasks.
+ */
+
+#ifndef THREADPOOL_HH
+#define THREADPOOL_HH
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+	public:
+	/**
+	 * Start the given number of threads (as many as hardware threads if zero).
+	 */
+	explicit ThreadPool(unsigned nrThreads = 0);
+	ThreadPool(const ThreadPool&) = delete;
+
+	/**
+	 * Wait for the pending tasks to finish and stop the threads.
+	 */
+	~ThreadPool();
+
+	/**
+	 * Queue a task to be run by some thread.
+	 */
+	void submit(std::function<void()>&& task);
+
+	/**
+	 * Wait until all submitted tasks have finished.
+	 */
+	void wait();
+
+	/**
+	 * Number of threads in the pool.
+	 */
+	size_t size() const { return threads.size(); }
+
+	private:
+	void work();
+
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable available; // a task has been queued
+	std::condition_variable finished;  // all tasks have finished
+	size_t running = 0;
+	bool stopping = false;
+};
+
+#endif // THREADPOOL_HH
@@ -0,0 +1,152 @@
+/**
+ * @file trace.cc
+ *
+ * Timeline of the normalization in the Chrome trace-event format.
+ */
+
+#include <sstream>
+#include <thread>
+
+#include "trace.hh"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+Tracer* Tracer::active = nullptr;
+
+// Nesting depth of the spans of this thread and depth of the outermost
+// omitted span (spans within omitted spans are omitted too)
+thread_local unsigned depth = 0;
+thread_local unsigned omittedDepth = 0;
+
+/**
+ * Write a string in JSON syntax.
+ */
+void
+quoteJson(ostream& out, const string& text)
+{
+	out << '"';
+
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if ((unsigned char) c < 0x20)
+			out << ' ';
+		else
+			out << c;
+	}
+
+	out << '"';
+}
+
+Tracer::Tracer(ostream& out, unsigned maxDepth, double sampleRate)
+  : out(out)
+  , maxDepth(maxDepth)
+  , sampleRate(sampleRate)
+  , origin(Clock::now())
+{
+	out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+	active = this;
+}
+
+Tracer::~Tracer()
+{
+	active = nullptr;
+	out << "\n]}\n";
+	out.flush();
+}
+
+bool
+Tracer::sample()
+{
+	lock_guard<std::mutex> lock(mutex);
+
+	// Deterministic sampling, recording a span whenever
+	// the accumulated rate reaches a whole span
+	sampleCredit += sampleRate;
+
+	if (sampleCredit >= 1) {
+		sampleCredit -= 1;
+		return true;
+	}
+
+	return false;
+}
+
+void
+Tracer::write(const char* name, Clock::time_point start, Clock::time_point end,
+              const string& args)
+{
+	using micros = chrono::duration<double, micro>;
+
+	ostringstream event;
+	event.precision(3);
+	event << fixed << "{\"name\": \"" << name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+	      << hash<thread::id>()(this_thread::get_id()) % 100000
+	      << ", \"ts\": " << micros(start - origin).count()
+	      << ", \"dur\": " << micros(end - start).count();
+
+	if (!args.empty())
+		event << ", \"args\": {" << args << "}";
+
+	event << "}";
+
+	lock_guard<std::mutex> lock(mutex);
+	out << (first ? "" : ",\n") << event.str();
+	first = false;
+}
+
+TraceSpan::TraceSpan(const char* name, const Node* formula)
+  : name(name)
+{
+	Tracer* tracer = Tracer::active;
+
+	if (!tracer)
+		return;
+
+	++depth;
+
+	if (omittedDepth > 0 || (tracer->maxDepth > 0 && depth > tracer->maxDepth) ||
+	    (formula && !tracer->sample())) {
+		state = State::OMITTED;
+
+		if (omittedDepth == 0)
+			omittedDepth = depth;
+		return;
+	}
+
+	state = State::RECORDED;
+
+	if (formula)
+		args = "\"tree_size\": " + to_string(treeSize(formula)) +
+		       ", \"dag_size\": " + to_string(dagSize(formula));
+
+	// Sizes are calculated before the span starts
+	start = Clock::now();
+}
+
+TraceSpan::~TraceSpan()
+{
+	if (state == State::INACTIVE)
+		return;
+
+	if (state == State::RECORDED && Tracer::active)
+		Tracer::active->write(name, start, Clock::now(), args);
+
+	if (omittedDepth == depth)
+		omittedDepth = 0;
+
+	--depth;
+}
+
+void
+TraceSpan::annotate(const char* key, const string& value)
+{
+	if (state != State::RECORDED)
+		return;
+
+	ostringstream arg;
+	arg << (args.empty() ? "\"" : ", \"") << key << "\": ";
+	quoteJson(arg, value);
+	args += arg.str();
+}
@@ -0,0 +1,98 @@
+/**
+ * @file trace.hh
+ *
+ * Timeline of the normalization in the Chrome trace-event format.
+ *
+ * While a Tracer is active, TraceSpan objects record the interval of their
+ * lifetime as complete events, which can be opened with Perfetto or the
+ * about:tracing page of Chromium. Spans nested beyond a maximum depth are
+ * omitted, and spans for rule applications can be sampled at a given rate
+ * (an omitted span omits all the spans nested within it), so that traces of
+ * exponential normalizations remain bounded.
+ */
+
+#ifndef TRACE_HH
+#define TRACE_HH
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include "tree.hh"
+
+class Tracer
+{
+	public:
+	/**
+	 * Start tracing into the given stream.
+	 *
+	 * @param maxDepth Maximum nesting depth of the spans (0 for no limit).
+	 * @param sampleRate Fraction of the rule spans to be recorded.
+	 */
+	Tracer(std::ostream& out, unsigned maxDepth, double sampleRate);
+	Tracer(const Tracer&) = delete;
+
+	/**
+	 * Stop tracing and complete the trace file.
+	 */
+	~Tracer();
+
+	/**
+	 * Active tracer (or null if tracing is disabled).
+	 */
+	static Tracer* active;
+
+	private:
+	friend class TraceSpan;
+
+	/**
+	 * Decide whether a rule span is sampled.
+	 */
+	bool sample();
+
+	void write(const char* name, std::chrono::steady_clock::time_point start,
+	           std::chrono::steady_clock::time_point end, const std::string& args);
+
+	std::ostream& out;
+	const unsigned maxDepth;
+	const double sampleRate;
+	double sampleCredit = 0;
+	bool first = true;
+	const std::chrono::steady_clock::time_point origin;
+	std::mutex mutex;
+};
+
+/**
+ * Span of the trace during the lifetime of the object.
+ */
+class TraceSpan
+{
+	public:
+	/**
+	 * Open a span, annotated with the tree and DAG sizes of the given
+	 * formula (if any). Spans with a formula are sampled.
+	 */
+	explicit TraceSpan(const char* name, const Node* formula = nullptr);
+	~TraceSpan();
+
+	/**
+	 * Annotate the span with a text.
+	 */
+	void annotate(const char* key, const std::string& value);
+
+	private:
+	enum class State
+	{
+		INACTIVE, // Tracing disabled
+		OMITTED,  // Too deep or not sampled
+		RECORDED
+	};
+
+	const char* name;
+	State state = State::INACTIVE;
+	std::string args;
+	std::chrono::steady_clock::time_point start;
+};
+
+#endif // TRACE_HH
@@ -6,7 +6,11 @@
 
 #include <algorithm>
 #include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
+#include "stats.hh"
 #include "tree.hh"
 
 using namespace std;
@@ -19,18 +23,58 @@ using Op = Node::Op;
 Node* Node::ttNode = new Node(Op::TT);
 Node* Node::ffNode = new Node(Op::FF);
 map<string, Node*> aprops;
+mutex apropsMutex;
 
 /*
- * Apply a function every element of a vector generating a new one.
+ * Apply a function every element of a list generating a new one.
  */
-inline vector<Node*>
-mapfn(const vector<Node*>& args, Node* fn(Node*))
+inline NodeList
+mapfn(const NodeList& args, Node* fn(Node*))
 {
-	vector<Node*> newArgs(args.size());
+	NodeList newArgs(args.size());
 	transform(args.begin(), args.end(), newArgs.begin(), fn);
 	return newArgs;
 }
 
+//
+//	Lists of arguments
+//
+
+NodeList::NodeList(size_t count)
+  : count(count)
+{
+	if (count > INLINE_SIZE)
+		heap.resize(count);
+}
+
+NodeList::NodeList(initializer_list<Node*> args)
+  : count(args.size())
+{
+	if (count > INLINE_SIZE)
+		heap.assign(args);
+	else
+		copy(args.begin(), args.end(), local);
+}
+
+NodeList::NodeList(vector<Node*>&& args)
+  : count(args.size())
+{
+	if (count > INLINE_SIZE)
+		heap = move(args);
+	else
+		copy(args.begin(), args.end(), local);
+}
+
+void
+NodeList::erase(const_iterator position)
+{
+	// The vector is not shrunk, since data() would switch to the inline
+	// storage when emptied while the iterators still point into the heap
+	Node** first = data() + (position - data());
+	copy(first + 1, end(), first);
+	count--;
+}
+
 //
 //	Private constructors without simplification
 //
@@ -48,30 +92,75 @@ Node::Node(Op type)
 
 Node::Node(Op type, Node* left, Node* right)
   : type(type)
-  , children(right ? 2 : 1)
+  , children(right ? NodeList{ left, right } : NodeList{ left })
 {
-	children[0] = left;
 	left->addUser();
-	if (right) {
-		children[1] = right;
+	if (right)
 		right->addUser();
-	}
+
+	classify();
+	countNode(this, true);
 }
 
-Node::Node(Op type, const std::vector<Node*>& args)
+Node::Node(Op type, NodeList&& args)
   : type(type)
-  , children(args)
+  , children(move(args))
 {
 	for (Node* child : children)
 		child->addUser();
+
+	classify();
+	countNode(this, true);
 }
 
-Node::Node(Op type, std::vector<Node*>&& args)
+Node::Node(Op type, NodeRef&& left, NodeRef&& right)
   : type(type)
-  , children(args)
 {
+	// The references of the arguments become those of the node
+	children = right ? NodeList{ left.transfer(), right.transfer() } : NodeList{ left.transfer() };
+
+	classify();
+	countNode(this, true);
+}
+
+void
+Node::classify()
+{
+	// Classes shared by all the children
+	uint8_t common = ALL_CLASSES;
+
 	for (Node* child : children)
-		child->addUser();
+		common &= child->classes;
+
+	switch (type) {
+		case Op::AND:
+		case Op::OR:
+			classes = common;
+			break;
+		case Op::X:
+			classes = common & (GUARANTEE | SAFETY | PERSISTENCE);
+			break;
+		case Op::U:
+		case Op::M:
+			classes = common & (GUARANTEE | PERSISTENCE);
+			break;
+		case Op::W:
+		case Op::R:
+			classes = (common & SAFETY) ? SAFETY | PERSISTENCE : 0;
+			break;
+		// GF and FG are only normal at the top level (below And and Or)
+		case Op::GF:
+			classes = (common & GUARANTEE) ? NORMAL : 0;
+			break;
+		case Op::FG:
+			classes = (common & SAFETY) ? NORMAL : 0;
+			break;
+		default:
+			classes = ALL_CLASSES;
+	}
+
+	if (classes & PERSISTENCE)
+		classes |= NORMAL;
 }
 
 //
@@ -93,6 +182,7 @@ Node::ff()
 Node*
 Node::ap(const string& name)
 {
+	lock_guard<mutex> lock(apropsMutex);
 	auto it = aprops.find(name);
 
 	if (it != aprops.end())
@@ -254,8 +344,124 @@ Node::FG(Node* arg)
 	return new Node(Op::FG, arg);
 }
 
+//
+//	Public constructors with simplification taking references
+//
+
+/**
+ * Whether the constructor with raw pointers would build a node of the given
+ * type with these arguments as is (without any simplification).
+ */
+bool
+buildsAsIs(Op type, const Node* left, const Node* right = nullptr)
+{
+	switch (type) {
+		case Op::X:
+			return !left->isConstant() && !is(left, Op::GF) && !is(left, Op::FG);
+		case Op::U:
+			return !is(left, Op::FF) && left != right && !right->isConstant() &&
+			       !right->isF() && !(is(left, Op::TT) && (is(right, Op::OR) || right->isG()));
+		case Op::W:
+			return !left->isConstant() && left != right && !is(right, Op::TT) && !left->isG() &&
+			       !(is(right, Op::FF) && (is(left, Op::AND) || left->isF()));
+		case Op::R:
+			return !is(left, Op::TT) && left != right && !right->isConstant() &&
+			       !right->isG() && !(is(left, Op::FF) && (is(right, Op::AND) || right->isF()));
+		case Op::M:
+			return !left->isConstant() && left != right && !is(right, Op::FF) && !left->isF() &&
+			       !(is(right, Op::TT) && (is(left, Op::OR) || left->isG()));
+		case Op::GF:
+			return !left->isConstant() && !is(left, Op::X) && !left->isF();
+		case Op::FG:
+			return !left->isConstant() && !is(left, Op::X) && !left->isG();
+		default:
+			return false;
+	}
+}
+
+/**
+ * Drop the references to the arguments of a node built by the constructor
+ * with raw pointers, which may have returned one of them (whose reference
+ * is then given up without releasing it).
+ */
+inline Node*
+dropArgs(Node* result, NodeRef& left, NodeRef&& right = NodeRef())
+{
+	for (NodeRef* arg : { &left, &right }) {
+		if (arg->get() == result)
+			arg->detach();
+		else
+			*arg = NodeRef();
+	}
+
+	return result;
+}
+
+Node*
+Node::X(NodeRef&& arg)
+{
+	if (buildsAsIs(Op::X, arg.get()))
+		return new Node(Op::X, move(arg), NodeRef());
+
+	return dropArgs(X(arg.get()), arg);
+}
+
+Node*
+Node::U(NodeRef&& left, NodeRef&& right)
+{
+	if (buildsAsIs(Op::U, left.get(), right.get()))
+		return new Node(Op::U, move(left), move(right));
+
+	return dropArgs(U(left.get(), right.get()), left, move(right));
+}
+
 Node*
-Node::And(vector<Node*>&& args)
+Node::W(NodeRef&& left, NodeRef&& right)
+{
+	if (buildsAsIs(Op::W, left.get(), right.get()))
+		return new Node(Op::W, move(left), move(right));
+
+	return dropArgs(W(left.get(), right.get()), left, move(right));
+}
+
+Node*
+Node::R(NodeRef&& left, NodeRef&& right)
+{
+	if (buildsAsIs(Op::R, left.get(), right.get()))
+		return new Node(Op::R, move(left), move(right));
+
+	return dropArgs(R(left.get(), right.get()), left, move(right));
+}
+
+Node*
+Node::M(NodeRef&& left, NodeRef&& right)
+{
+	if (buildsAsIs(Op::M, left.get(), right.get()))
+		return new Node(Op::M, move(left), move(right));
+
+	return dropArgs(M(left.get(), right.get()), left, move(right));
+}
+
+Node*
+Node::GF(NodeRef&& arg)
+{
+	if (buildsAsIs(Op::GF, arg.get()))
+		return new Node(Op::GF, move(arg), NodeRef());
+
+	return dropArgs(GF(arg.get()), arg);
+}
+
+Node*
+Node::FG(NodeRef&& arg)
+{
+	if (buildsAsIs(Op::FG, arg.get()))
+		return new Node(Op::FG, move(arg), NodeRef());
+
+	return dropArgs(FG(arg.get()), arg);
+}
+
+Node*
+Node::And(NodeList&& args)
 {
 	for (auto it = args.rbegin(); it != args.rend(); it++) {
 		if (is(*it, Op::FF)) {
@@ -272,11 +478,11 @@ Node::And(vector<Node*>&& args)
 	if (args.size() == 1)
 		return args[0];
 
-	return new Node(Op::AND, args);
+	return new Node(Op::AND, move(args));
 }
 
 Node*
-Node::Or(vector<Node*>&& args)
+Node::Or(NodeList&& args)
 {
 	for (auto it = args.rbegin(); it != args.rend(); it++) {
 		if (is(*it, Op::TT)) {
@@ -293,11 +499,11 @@ Node::Or(vector<Node*>&& args)
 	if (args.size() == 1)
 		return args[0];
 
-	return new Node(Op::OR, args);
+	return new Node(Op::OR, move(args));
 }
 
 Node*
-Node::make(Op type, vector<Node*>&& args)
+Node::make(Op type, NodeList&& args)
 {
 	switch (type) {
 		case Op::TT:
@@ -345,6 +551,7 @@ Node::release()
 		for (Node* child : children)
 			child->removeUser();
 
+		countNode(this, false);
 		delete this;
 	}
 }
@@ -402,3 +609,111 @@ equal(Node* left, Node*& right)
 
 	return false;
 }
+
+Node*
+releaseTable(const vector<Node*>& table, Node* root)
+{
+	// The root is protected from deletion while the table is released
+	// (addUser/removeUser are not used because removeUser would delete it)
+	if (root)
+		root->refCount++;
+
+	for (Node* node : table)
+		node->removeUser();
+
+	if (root)
+		root->refCount--;
+
+	return root;
+}
+
+//
+//	Structural hash
+//
+
+/*
+ * Combine a word into a FNV-1a hash.
+ */
+inline uint64_t
+hashCombine(uint64_t hash, uint64_t word)
+{
+	for (int i = 0; i < 8; ++i, word >>= 8)
+		hash = (hash ^ (word & 0xff)) * 1099511628211ull;
+
+	return hash;
+}
+
+uint64_t
+structuralHash(const Node* node, unordered_map<const Node*, uint64_t>& hashes)
+{
+	auto it = hashes.find(node);
+
+	if (it != hashes.end())
+		return it->second;
+
+	uint64_t hash = hashCombine(14695981039346656037ull, uint64_t(node->type));
+
+	for (char c : node->name)
+		hash = hashCombine(hash, uint8_t(c));
+
+	for (const Node* child : node->children)
+		hash = hashCombine(hash, structuralHash(child, hashes));
+
+	return hashes[node] = hash;
+}
+
+uint64_t
+structuralHash(const Node* node)
+{
+	unordered_map<const Node*, uint64_t> hashes;
+	return structuralHash(node, hashes);
+}
+
+//
+//	Size of the formulae
+//
+
+size_t
+treeSize(const Node* node, unordered_map<const Node*, size_t>& sizes)
+{
+	if (node->isConstant())
+		return 0;
+
+	auto it = sizes.find(node);
+
+	if (it != sizes.end())
+		return it->second;
+
+	size_t size = 1;
+
+	for (const Node* child : node->children)
+		size += treeSize(child, sizes);
+
+	return sizes[node] = size;
+}
+
+size_t
+treeSize(const Node* node)
+{
+	// Shared subformulae are counted once per occurrence, but visited only once
+	unordered_map<const Node*, size_t> sizes;
+	return treeSize(node, sizes);
+}
+
+void
+collectNodes(const Node* node, unordered_set<const Node*>& seen)
+{
+	if (node->isConstant() || !seen.insert(node).second)
+		return;
+
+	for (const Node* child : node->children)
+		collectNodes(child, seen);
+}
+
+size_t
+dagSize(const Node* node)
+{
+	unordered_set<const Node*> seen;
+	collectNodes(node, seen);
+	return seen.size();
+}
@@ -7,9 +7,74 @@
 #ifndef TREE_HH
 #define TREE_HH
 
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
 #include <string>
+#include <utility>
 #include <vector>
 
+struct Node;
+class NodeRef;
+
+/**
+ * Arguments of a node, stored inline up to two of them (the arity of all
+ * operators except And and Or) and in a vector otherwise. Hence, unary and
+ * binary nodes are built and rebuilt without any allocation other than the
+ * node itself, and vectors of arguments are moved without copying.
+ */
+class NodeList
+{
+	public:
+	using iterator = Node**;
+	using const_iterator = Node* const*;
+
+	NodeList() = default;
+	explicit NodeList(size_t count);
+	NodeList(std::initializer_list<Node*> args);
+	NodeList(std::vector<Node*>&& args);
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	Node** data() { return heap.empty() ? local : heap.data(); }
+	Node* const* data() const { return heap.empty() ? local : heap.data(); }
+
+	Node*& operator[](size_t index) { return data()[index]; }
+	Node* operator[](size_t index) const { return data()[index]; }
+
+	iterator begin() { return data(); }
+	iterator end() { return data() + count; }
+	const_iterator begin() const { return data(); }
+	const_iterator end() const { return data() + count; }
+	std::reverse_iterator<const_iterator> rbegin() const
+	{
+		return std::reverse_iterator<const_iterator>(end());
+	}
+	std::reverse_iterator<const_iterator> rend() const
+	{
+		return std::reverse_iterator<const_iterator>(begin());
+	}
+
+	/**
+	 * Remove an argument (the arguments stay in the heap if they were).
+	 */
+	void erase(const_iterator position);
+
+	/**
+	 * Memory allocated for the arguments outside the list.
+	 */
+	size_t heapBytes() const { return heap.capacity() * sizeof(Node*); }
+
+	private:
+	static constexpr size_t INLINE_SIZE = 2;
+
+	size_t count = 0;
+	Node* local[INLINE_SIZE] = {};
+	std::vector<Node*> heap; // Arguments if not empty (maybe followed by erased ones)
+};
+
 struct Node
 {
 	enum class Op
@@ -28,11 +93,28 @@ struct Node
 		FG
 	};
 
+	/**
+	 * Syntactic classes of the safety-progress hierarchy, as flags.
+	 */
+	enum Class : uint8_t
+	{
+		GUARANTEE = 1,   // Σ₁ (without GF or FG)
+		SAFETY = 2,      // Π₁ (without GF or FG)
+		PERSISTENCE = 4, // Σ₂ (without GF or FG)
+		NORMAL = 8,      // Boolean combination of Σ₂, GF Σ₁ and FG Π₁
+		ALL_CLASSES = 15
+	};
+
 	Op type;
-	std::vector<Node*> children;
+	// Classes of the formula, computed bottom-up when the node is built
+	uint8_t classes = ALL_CLASSES;
+	NodeList children;
 	std::string name; // of atomic propositions
 
-	size_t refCount = 0;
+	// Atomic, since formulae may be normalized concurrently. The unique
+	// nodes (true, false and atomic propositions), which are shared by all
+	// formulae and never released, do not count their users.
+	std::atomic<size_t> refCount{ 0 };
 
 	/*
 	 * Deep self-destruction of this node if not used by others.
@@ -48,9 +130,21 @@ struct Node
 	void removeUser();
 
 	bool isConstant() const;
+	bool isUnique() const;
 	bool isG() const;
 	bool isF() const;
 
+	/**
+	 * Whether the formula is already in normal form, so that every step of
+	 * the normalization leaves it unchanged.
+	 */
+	bool isNormal() const;
+
+	/**
+	 * Compute the classes of this node from those of its children.
+	 */
+	void classify();
+
 	bool operator==(const Node& other) const;
 	bool operator!=(const Node& other) const;
 
@@ -62,8 +156,8 @@ struct Node
 	static Node* ff();
 	static Node* ap(const std::string& name);
 	static Node* X(Node* arg);
-	static Node* And(std::vector<Node*>&& args);
-	static Node* Or(std::vector<Node*>&& args);
+	static Node* And(NodeList&& args);
+	static Node* Or(NodeList&& args);
 	static Node* U(Node* left, Node* right);
 	static Node* W(Node* left, Node* right);
 	static Node* R(Node* left, Node* right);
@@ -73,7 +167,20 @@ struct Node
 	static Node* G(Node* arg);
 	static Node* F(Node* arg);
 
-	static Node* make(Op type, std::vector<Node*>&& args);
+	// The same constructors taking the references to their arguments, which
+	// are handed to the new node without updating their reference counts
+	// (or dropped if the arguments are not used by the result)
+	static Node* X(NodeRef&& arg);
+	static Node* U(NodeRef&& left, NodeRef&& right);
+	static Node* W(NodeRef&& left, NodeRef&& right);
+	static Node* R(NodeRef&& left, NodeRef&& right);
+	static Node* M(NodeRef&& left, NodeRef&& right);
+	static Node* GF(NodeRef&& arg);
+	static Node* FG(NodeRef&& arg);
+	static Node* G(NodeRef&& arg);
+	static Node* F(NodeRef&& arg);
+
+	static Node* make(Op type, NodeList&& args);
 
 	/*
 	 * Release the unique nodes (true, false and atomic propositions).
@@ -84,8 +191,8 @@ struct Node
 	Node(Op type);
 	Node(const std::string& name);
 	Node(Op type, Node* left, Node* right = nullptr);
-	Node(Op type, const std::vector<Node*>& args);
-	Node(Op type, std::vector<Node*>&& args);
+	Node(Op type, NodeList&& args);
+	Node(Op type, NodeRef&& left, NodeRef&& right);
 
 	static Node* ttNode;
 	static Node* ffNode;
@@ -96,6 +203,29 @@ struct Node
  */
 bool equal(Node* left, Node*& right);
 
+/**
+ * Release a table of nodes whose users were incremented to keep them alive
+ * while building a formula, except its root, which is returned without users
+ * like any other freshly built formula.
+ */
+Node* releaseTable(const std::vector<Node*>& table, Node* root);
+
+/**
+ * Hash of the structure of a formula, which does not depend on the addresses
+ * of its nodes (so it can be stored and compared between different runs).
+ */
+uint64_t structuralHash(const Node* node);
+
+/**
+ * Number of nodes of the formula when written as a tree (constants excluded).
+ */
+size_t treeSize(const Node* node);
+
+/**
+ * Number of distinct nodes in the DAG of the formula (constants excluded).
+ */
+size_t dagSize(const Node* node);
+
 /**
  * Return the first argument and release the second, which has been superseeded
  * by the first in the context where this is called. It is only a convenience
@@ -126,6 +256,29 @@ is(const Node* node, Node::Op type)
 	return node->type == type;
 }
 
+/**
+ * Number of arguments of an operator (-1 for variadic ones).
+ */
+inline int
+arity(Node::Op type)
+{
+	switch (type) {
+		case Node::Op::TT:
+		case Node::Op::FF:
+		case Node::Op::APROP:
+			return 0;
+		case Node::Op::X:
+		case Node::Op::GF:
+		case Node::Op::FG:
+			return 1;
+		case Node::Op::AND:
+		case Node::Op::OR:
+			return -1;
+		default:
+			return 2;
+	}
+}
+
 inline bool
 Node::isG() const
 {
@@ -140,12 +293,24 @@ Node::isF() const
 	       (type == Op::M && is(children[1], Op::TT));
 }
 
+inline bool
+Node::isNormal() const
+{
+	return classes & NORMAL;
+}
+
 inline bool
 Node::isConstant() const
 {
 	return type == Op::TT || type == Op::FF;
 }
 
+inline bool
+Node::isUnique() const
+{
+	return type == Op::TT || type == Op::FF || type == Op::APROP;
+}
+
 inline bool
 Node::operator!=(const Node& other) const
 {
@@ -155,14 +320,104 @@ Node::operator!=(const Node& other) const
 inline void
 Node::addUser()
 {
-	refCount++;
+	if (!isUnique())
+		refCount++;
 }
 
 inline void
 Node::removeUser()
 {
-	if (--refCount == 0)
+	if (!isUnique() && --refCount == 0)
 		release();
 }
 
+/**
+ * Reference to a node that keeps it alive during the lifetime of the object.
+ *
+ * Freshly built nodes have no users and the first parent they are given to
+ * becomes their user, so references are only needed where a formula must
+ * outlive calls that may release it. They are moved without updating the
+ * reference count, even into the node constructors taking them, whose new
+ * node takes over the references to its arguments.
+ */
+class NodeRef
+{
+	public:
+	NodeRef() = default;
+
+	explicit NodeRef(Node* node)
+	  : node(node)
+	{
+		if (node)
+			node->addUser();
+	}
+
+	NodeRef(const NodeRef& other)
+	  : NodeRef(other.node)
+	{}
+
+	NodeRef(NodeRef&& other) noexcept
+	  : node(other.node)
+	{
+		other.node = nullptr;
+	}
+
+	~NodeRef()
+	{
+		if (node)
+			node->removeUser();
+	}
+
+	NodeRef& operator=(NodeRef other) noexcept
+	{
+		std::swap(node, other.node);
+		return *this;
+	}
+
+	Node* get() const { return node; }
+	Node* operator->() const { return node; }
+	explicit operator bool() const { return node != nullptr; }
+
+	/**
+	 * Give up the reference without releasing the node, which is returned
+	 * like a freshly built one if it has no other users.
+	 */
+	Node* detach()
+	{
+		Node* detached = node;
+		node = nullptr;
+
+		if (detached && !detached->isUnique())
+			detached->refCount--;
+
+		return detached;
+	}
+
+	/**
+	 * Give up the reference without updating the reference count, which
+	 * now accounts for a user taking over the reference.
+	 */
+	Node* transfer()
+	{
+		Node* transferred = node;
+		node = nullptr;
+		return transferred;
+	}
+
+	private:
+	Node* node = nullptr;
+};
+
+inline Node*
+Node::G(NodeRef&& arg)
+{
+	return Node::W(std::move(arg), NodeRef(Node::ff()));
+}
+
+inline Node*
+Node::F(NodeRef&& arg)
+{
+	return Node::U(NodeRef(Node::tt()), std::move(arg));
+}
+
 #endif // TREE_HH
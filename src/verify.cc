@@ -0,0 +1,518 @@
+/**
+ * @file verify.cc
+ *
+ * Check that the normal forms of a file of formulae are in the class Δ₂
+ * and equivalent to the original formulae.
+ *
+ * Spot is not thread-safe, so the formulae are checked by a pool of worker
+ * processes. Each check runs with a time limit, after which the worker is
+ * killed and replaced by a new one. The formulae are assigned to the workers
+ * from the most to the least expensive (according to their estimated cost),
+ * so that a slow formula at the end does not delay the whole run. The results
+ * can be written in the CSV format of scripts/check.py.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <spot/tl/nenoform.hh>
+#include <spot/tl/parse.hh>
+#include <spot/twaalgos/contains.hh>
+
+#include "estimate.hh"
+#include "normalizer.hh"
+#include "pipeline.hh"
+#include "spotnorm.hh"
+
+using namespace std;
+using formula = spot::formula;
+using op = spot::op;
+
+struct VerifyOptions
+{
+	unsigned jobs = 0;            // Worker processes (0 for all processors)
+	unsigned timeout = 60;        // Seconds for each formula
+	bool equivCheck = true;       // Check the equivalence of the normal forms
+	unsigned simplify = 0;        // Level of simplification before normalizing
+	Engine engine = Engine::NODE; // Normalization engine
+	const char* output = nullptr; // CSV file with the results
+	const char* file = nullptr;
+};
+
+//
+//	Properties of the formulae (as in scripts/formula_props.py)
+//
+
+/**
+ * Argument of a G formula (or null).
+ */
+formula
+isG(const formula& f)
+{
+	if (f.kind() == op::G || (f.kind() == op::W && f[1].is_ff()))
+		return f[0];
+	else if (f.kind() == op::R && f[0].is_ff())
+		return f[1];
+	else
+		return formula();
+}
+
+/**
+ * Argument of an F formula (or null).
+ */
+formula
+isF(const formula& f)
+{
+	if (f.kind() == op::F || (f.kind() == op::M && f[1].is_tt()))
+		return f[0];
+	else if (f.kind() == op::U && f[0].is_tt())
+		return f[1];
+	else
+		return formula();
+}
+
+/**
+ * Whether a formula is normalized with GF for Π₂.
+ */
+bool
+normalizedGF(const formula& f)
+{
+	if (f.kind() == op::And || f.kind() == op::Or) {
+		for (const formula& child : f)
+			if (!normalizedGF(child))
+				return false;
+		return true;
+	}
+
+	if (f.is_syntactic_persistence())
+		return true;
+
+	formula g = isG(f), h = g ? isF(g) : formula();
+	return h && h.is_syntactic_guarantee();
+}
+
+/**
+ * Whether a formula is normalized (in Δ₂).
+ */
+bool
+normalized(const formula& f)
+{
+	if (f.is_syntactic_persistence() || f.is_syntactic_recurrence())
+		return true;
+
+	if (f.kind() == op::And || f.kind() == op::Or) {
+		for (const formula& child : f)
+			if (!normalized(child))
+				return false;
+		return true;
+	}
+
+	return false;
+}
+
+//
+//	Checks (in the worker processes)
+//
+
+/**
+ * Normalize and check a formula.
+ *
+ * @return The line with the result for the main process, which starts with
+ * the status (ok, error or not) followed by a tab, the CSV row and a tab
+ * with the normal form.
+ */
+string
+checkFormula(const string& text, const string& file, const VerifyOptions& options)
+{
+	spot::parsed_formula parsed = spot::parse_infix_psl(text);
+	ostringstream errors;
+
+	if (parsed.format_errors(errors))
+		return "error\t\t" + errors.str().substr(0, errors.str().find('\n'));
+
+	const formula input = spot::negative_normal_form(parsed.f);
+
+	const auto start = chrono::steady_clock::now();
+	formula result;
+
+	if (options.engine == Engine::SPOT)
+		result = normalizeSpot(input);
+	else {
+		NodeRef tree(readFormula(input));
+		tree = NodeRef(simplifyFormula(tree.get(), options.simplify));
+		NodeRef normal(normalize(tree.get()));
+		result = writeFormula(normal.get());
+	}
+
+	const auto elapsed = chrono::steady_clock::now() - start;
+
+	const bool finalNormal = normalized(result);
+	const bool equivalent = !options.equivCheck || spot::are_equivalent(input, result);
+
+	// The CSV row, with the same columns as check.py
+	ostringstream row;
+	const char* boolean[] = { "False", "True" };
+	string quoted = text;
+
+	for (size_t pos = 0; (pos = quoted.find('"', pos)) != string::npos; pos += 2)
+		quoted.insert(pos, 1, '"');
+
+	row << file << ",\"" << quoted << "\"," << boolean[normalized(input)] << ','
+	    << boolean[normalizedGF(input)] << ",cpp,"
+	    << chrono::duration_cast<chrono::nanoseconds>(elapsed).count() << ','
+	    << treeSize(input) << ',' << dagSize(input) << ',' << treeSize(result) << ','
+	    << dagSize(result) << ',' << boolean[finalNormal] << ',' << boolean[normalizedGF(result)];
+
+	const char* status = !equivalent ? "not equivalent" : !finalNormal ? "not normalized" : "ok";
+
+	return string(status) + "\t" + row.str() + "\t" + spot::str_psl(result);
+}
+
+/**
+ * Loop of a worker process, which receives the indices of the formulae to
+ * be checked and answers with a line for each of them.
+ */
+[[noreturn]] void
+workerLoop(int requests, int responses, const vector<string>& formulae,
+           const VerifyOptions& options)
+{
+	uint32_t index;
+
+	while (read(requests, &index, sizeof(index)) == sizeof(index)) {
+		// The process is killed by the alarm if the time limit is exceeded
+		alarm(options.timeout);
+		const string line = checkFormula(formulae[index], options.file, options) + "\n";
+		alarm(0);
+
+		size_t written = 0;
+
+		while (written < line.size()) {
+			ssize_t count = write(responses, line.data() + written, line.size() - written);
+
+			if (count < 0 && errno != EINTR)
+				_exit(1);
+
+			written += max<ssize_t>(count, 0);
+		}
+	}
+
+	_exit(0);
+}
+
+//
+//	Pool of worker processes (in the main process)
+//
+
+struct Worker
+{
+	pid_t pid = -1;
+	int requests = -1;  // Pipe to send indices to the worker
+	int responses = -1; // Pipe to receive results from the worker
+	string buffer;      // Incomplete response
+	long current = -1;  // Formula being checked (or -1 if idle)
+};
+
+bool
+startWorker(Worker& worker, vector<Worker>& workers, const vector<string>& formulae,
+            const VerifyOptions& options)
+{
+	int requestPipe[2], responsePipe[2];
+
+	if (pipe(requestPipe) != 0 || pipe(responsePipe) != 0) {
+		cerr << "Error: cannot create pipes: " << strerror(errno) << ".\n";
+		return false;
+	}
+
+	const pid_t pid = fork();
+
+	if (pid < 0) {
+		cerr << "Error: cannot create a worker process: " << strerror(errno) << ".\n";
+		return false;
+	}
+
+	if (pid == 0) {
+		close(requestPipe[1]);
+		close(responsePipe[0]);
+
+		// Otherwise, the other workers would never see the end of their requests
+		for (Worker& other : workers)
+			if (other.pid > 0 && &other != &worker) {
+				close(other.requests);
+				close(other.responses);
+			}
+
+		workerLoop(requestPipe[0], responsePipe[1], formulae, options);
+	}
+
+	close(requestPipe[0]);
+	close(responsePipe[1]);
+
+	worker = { pid, requestPipe[1], responsePipe[0], {}, -1 };
+	return true;
+}
+
+void
+stopWorker(Worker& worker)
+{
+	close(worker.requests);
+	close(worker.responses);
+	waitpid(worker.pid, nullptr, 0);
+	worker.pid = -1;
+}
+
+struct Result
+{
+	string status = "pending";
+	string row;
+	string normalForm;
+};
+
+/**
+ * Order in which the formulae are checked, from the highest to the lowest
+ * estimated cost (malformed formulae go last).
+ */
+vector<uint32_t>
+scheduleOrder(const vector<string>& formulae)
+{
+	vector<double> work(formulae.size());
+	ostringstream errors;
+
+	for (size_t i = 0; i < formulae.size(); ++i) {
+		NodeRef tree(readFormula(formulae[i], Format::SPOT, errors));
+
+		if (tree)
+			work[i] = estimateCost(tree.get()).work;
+	}
+
+	vector<uint32_t> order(formulae.size());
+
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+
+	stable_sort(order.begin(), order.end(),
+	            [&work](uint32_t a, uint32_t b) { return work[a] > work[b]; });
+
+	return order;
+}
+
+bool
+verify(const vector<string>& formulae, const VerifyOptions& options, vector<Result>& results)
+{
+	unsigned jobs = options.jobs ? options.jobs : max(thread::hardware_concurrency(), 1u);
+	jobs = min<size_t>(jobs, max<size_t>(formulae.size(), 1));
+
+	vector<Worker> workers(jobs);
+
+	for (Worker& worker : workers)
+		if (!startWorker(worker, workers, formulae, options))
+			return false;
+
+	const vector<uint32_t> order = scheduleOrder(formulae);
+	size_t next = 0, done = 0;
+	vector<pollfd> polled(jobs);
+
+	while (done < formulae.size()) {
+		// Assign pending formulae to idle workers
+		for (Worker& worker : workers)
+			if (worker.current < 0 && next < formulae.size()) {
+				const uint32_t index = order[next++];
+				worker.current = index;
+
+				if (write(worker.requests, &index, sizeof(index)) != sizeof(index)) {
+					cerr << "Error: cannot communicate with a worker.\n";
+					return false;
+				}
+			}
+
+		for (unsigned i = 0; i < jobs; ++i)
+			polled[i] = { workers[i].responses, POLLIN, 0 };
+
+		if (poll(polled.data(), jobs, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		for (unsigned i = 0; i < jobs; ++i) {
+			if (!(polled[i].revents & (POLLIN | POLLHUP)))
+				continue;
+
+			Worker& worker = workers[i];
+			char buffer[4096];
+			const ssize_t count = read(worker.responses, buffer, sizeof(buffer));
+
+			if (count > 0) {
+				worker.buffer.append(buffer, count);
+				const size_t end = worker.buffer.find('\n');
+
+				if (end == string::npos)
+					continue;
+
+				// Status, CSV row and normal form separated by tabs
+				istringstream line(worker.buffer.substr(0, end));
+				Result& result = results[worker.current];
+				getline(line, result.status, '\t');
+				getline(line, result.row, '\t');
+				getline(line, result.normalForm);
+
+				worker.buffer.clear();
+				worker.current = -1;
+				done++;
+			}
+			// The worker has died (by the alarm or by a crash)
+			else if (count == 0 || errno != EINTR) {
+				int status = 0;
+				close(worker.requests);
+				close(worker.responses);
+				waitpid(worker.pid, &status, 0);
+
+				if (worker.current >= 0) {
+					const bool timeout = WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM;
+					results[worker.current].status = timeout ? "timeout" : "crash";
+					done++;
+				}
+
+				if (!startWorker(worker, workers, formulae, options))
+					return false;
+			}
+		}
+	}
+
+	for (Worker& worker : workers)
+		stopWorker(worker);
+
+	return true;
+}
+
+//
+//	Command-line interface
+//
+
+void
+usage(const char* progname)
+{
+	cerr << "Usage: " << progname << " [options] file\n\n"
+	     << "Check that the normal forms of the formulae in the file are in\n"
+	     << "the class Delta2 and equivalent to the original formulae.\n\n"
+	     << "Options:\n"
+	     << "  --jobs=N         number of worker processes (all processors\n"
+	     << "                   by default)\n"
+	     << "  --timeout=S      time limit for each formula in seconds (60 by\n"
+	     << "                   default)\n"
+	     << "  --no-equiv       do not check the equivalence of the normal forms\n"
+	     << "  --simplify=N     simplify the formulae before normalizing them\n"
+	     << "                   at the given level (as in ltlnorm)\n"
+	     << "  --engine=NAME    normalization engine (node by default or spot, as\n"
+	     << "                   in ltlnorm, without simplification)\n"
+	     << "  --output=PATH    write the results in the CSV format of check.py\n";
+}
+
+bool
+parseOptions(int argc, char* argv[], VerifyOptions& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		char* end = nullptr;
+
+		if (strncmp(arg, "--jobs=", 7) == 0)
+			options.jobs = strtoul(arg + 7, &end, 10);
+		else if (strncmp(arg, "--timeout=", 10) == 0)
+			options.timeout = strtoul(arg + 10, &end, 10);
+		else if (strcmp(arg, "--no-equiv") == 0)
+			options.equivCheck = false;
+		else if (strncmp(arg, "--simplify=", 11) == 0) {
+			options.simplify = strtoul(arg + 11, &end, 10);
+
+			if (options.simplify > maxSimplifyLevel)
+				return false;
+		}
+		else if (strncmp(arg, "--engine=", 9) == 0) {
+			if (!parseEngine(arg + 9, options.engine))
+				return false;
+		} else if (strncmp(arg, "--output=", 9) == 0)
+			options.output = arg + 9;
+		else if (arg[0] == '-' || options.file)
+			return false;
+		else
+			options.file = arg;
+
+		if (end && *end != '\0')
+			return false;
+	}
+
+	return options.file != nullptr && (options.engine == Engine::NODE || options.simplify == 0);
+}
+
+int
+main(int argc, char* argv[])
+{
+	VerifyOptions options;
+
+	if (!parseOptions(argc, argv, options)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	ifstream in(options.file);
+
+	if (!in) {
+		cerr << "Error: cannot open " << options.file << ".\n";
+		return 1;
+	}
+
+	// Empty lines are ignored as in check.py
+	vector<string> formulae;
+	string line;
+
+	while (getline(in, line))
+		if (!line.empty())
+			formulae.push_back(line);
+
+	vector<Result> results(formulae.size());
+
+	if (!verify(formulae, options, results))
+		return 1;
+
+	ofstream csv;
+
+	if (options.output) {
+		csv.open(options.output);
+		csv << "file,formula,already_normal,already_gfnorm,imp,time,init_size,init_dagsize,"
+		       "fin_size,fin_dagsize,final_normal,final_gfnorm\n";
+	}
+
+	size_t errors = 0;
+
+	for (size_t i = 0; i < formulae.size(); ++i) {
+		const Result& result = results[i];
+
+		if (result.status != "ok") {
+			cout << "(" << i << ") " << formulae[i] << " ---- " << result.status;
+
+			if (!result.normalForm.empty())
+				cout << " " << result.normalForm;
+
+			cout << "\n";
+			errors++;
+		}
+
+		if (csv.is_open() && !result.row.empty())
+			csv << result.row << "\n";
+	}
+
+	cout << formulae.size() << " formulae checked with " << errors << " errors.\n";
+
+	return errors == 0 ? 0 : 1;
+}